@@ -4,402 +4,1606 @@
 #include <sstream>      
 #include <iomanip>      
 #include <algorithm>    
-#include <exception>    
+#include <cstddef>
+#include <type_traits>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <typeinfo>
 #include "Assembler.h"
 #include "error.h"
-#include "table.h"
+#include "object.h"
+#include "binary.h"
+#include "pool.h"
+#include "cache.h"
+#include "snapshot.h"
+#include "spill.h"
+#include <memory>
 
+// Map an operation mnemonic to the directive it names, NONE for instructions
+static Directive directiveKind(std::string_view operation) {
+    if (equalsIgnoreCase(operation, "START")) return Directive::START;
+    if (equalsIgnoreCase(operation, "END"))   return Directive::END;
+    if (equalsIgnoreCase(operation, "USE"))   return Directive::USE;
+    if (equalsIgnoreCase(operation, "BYTE"))  return Directive::BYTE;
+    if (equalsIgnoreCase(operation, "WORD"))  return Directive::WORD;
+    if (equalsIgnoreCase(operation, "RESB"))  return Directive::RESB;
+    if (equalsIgnoreCase(operation, "RESW"))  return Directive::RESW;
+    if (equalsIgnoreCase(operation, "CSECT")) return Directive::CSECT;
+    if (equalsIgnoreCase(operation, "EXTDEF")) return Directive::EXTDEF;
+    if (equalsIgnoreCase(operation, "EXTREF")) return Directive::EXTREF;
+    if (equalsIgnoreCase(operation, "MACRO")) return Directive::MACRO;
+    if (equalsIgnoreCase(operation, "MEND"))  return Directive::MEND;
+    if (equalsIgnoreCase(operation, "LTORG")) return Directive::LTORG;
+    if (equalsIgnoreCase(operation, "BASE"))  return Directive::BASE;
+    if (equalsIgnoreCase(operation, "NOBASE")) return Directive::NOBASE;
+    return Directive::NONE;
+}
+
+// Output files are named after the source with its extension removed
+static std::string outputBase(const std::string& filename) {
+    return std::filesystem::path(filename).replace_extension().string();
+}
+
+static const char* directiveName(Directive directive) {
+    switch (directive) {
+        case Directive::START: return "START";
+        case Directive::END:   return "END";
+        case Directive::USE:   return "USE";
+        case Directive::BYTE:  return "BYTE";
+        case Directive::WORD:  return "WORD";
+        case Directive::RESB:  return "RESB";
+        case Directive::RESW:  return "RESW";
+        case Directive::CSECT: return "CSECT";
+        case Directive::EXTDEF: return "EXTDEF";
+        case Directive::EXTREF: return "EXTREF";
+        case Directive::MACRO: return "MACRO";
+        case Directive::MEND:  return "MEND";
+        case Directive::LTORG: return "LTORG";
+        case Directive::BASE:  return "BASE";
+        case Directive::NOBASE: return "NOBASE";
+        default:               return "";
+    }
+}
+
+// Operand written as a literal constant: =C'..', =X'..' or =n
+static bool isLiteral(std::string_view operand) {
+    return !operand.empty() && operand[0] == '=';
+}
+
+// Decode everything about a line that does not touch the symbol table.
+// symbolName receives the operand symbol of an instruction or BASE, if any.
+// The SIC/XE notations are decoded for every machine: +operation asks for
+// format 4, #operand is immediate and @operand indirect.
+static LineRecord decodeOperation(const Optab& optab, const SourceLine& tokens, int location, int block,
+                                  std::string_view& symbolName) {
+    LineRecord record{location, block, -1, directiveKind(tokens.operation), tokens.operand, SymbolTable::npos, false};
+    symbolName = std::string_view();
+    if (record.directive == Directive::BASE)
+        symbolName = tokens.operand;
+    if (record.directive != Directive::NONE)
+        return record;
+
+    std::string_view mnemonic = tokens.operation;
+    bool extended = mnemonic.size() > 1 && mnemonic[0] == '+';
+    if (extended)
+        mnemonic.remove_prefix(1);
+    int opcodeId = optab.find(mnemonic);
+    if (opcodeId >= 0) {
+        record.opcode = optab.value(opcodeId);
+        record.format = static_cast<unsigned char>(optab.format(opcodeId));
+    }
+    if (extended)
+        record.format = record.format == 3 ? 4 : 0;     // 0: only format 3 instructions extend
+    if (record.format < 3 || tokens.operand.empty())
+        return record;                                  // Registers and counts are not symbols
+
+    symbolName = tokens.operand;
+    if (symbolName[0] == '#' || symbolName[0] == '@') {
+        record.prefix = symbolName[0];
+        symbolName.remove_prefix(1);
+    }
+    size_t commaPos = symbolName.find(",X");
+    if (commaPos != std::string_view::npos) {
+        record.indexed = true;
+        symbolName = symbolName.substr(0, commaPos); // Remove ,X from operand
+    }
+    if (isLiteral(symbolName))
+        symbolName = std::string_view();    // Placed in a literal pool, not a symbol
+    if (record.prefix == '#' && !symbolName.empty() && (std::isdigit(static_cast<unsigned char>(symbolName[0])) || symbolName[0] == '-'))
+        symbolName = std::string_view();    // Immediate constant
+    return record;
+}
+
+LineRecord Assembler::decodeLine(const SourceLine& tokens, int location, int block, int section) {
+    std::string_view symbolName;
+    LineRecord record = decodeOperation(optab, tokens, location, block, symbolName);
+    if (record.directive == Directive::NONE)
+        stats.optab_lookups++;
+    // Resolve the operand to a symbol id now; forward references get an undefined entry
+    if (!symbolName.empty()) {
+        record.symbol = symtab.intern(symbolName, section);
+        stats.symbol_lookups++;
+    }
+    return record;
+}
+
+// A label defined twice keeps its later address, as it always has, but is
+// worth a warning
+void Assembler::defineLabel(int id, std::string_view label, int address, int block, int line) {
+    if (symtab.defined(id))
+        diags.warning("Duplicate symbol " + std::string(label) + ", the later definition is used", line, label);
+    symtab.define(id, address, block);
+    if (opts.cross_reference)
+        xref.define(id, line);
+}
+
+// Report a problem of a decoded line at its operand; lines of a macro
+// expansion have no view into the source and fall back to their line
+bool Assembler::lineError(const LineRecord& record, std::string message) {
+    return diags.error(std::move(message), record.line, record.operand);
+}
+
+void Assembler::reportDiagnostics() {
+    // A JSON consumer gets an answer for every file, even a clean one
+    if (diags.all().empty() && opts.diagnostic_format == DiagnosticFormat::TEXT)
+        return;
+    std::ostream* stream = errorStream();
+    diags.write(stream ? *stream : std::cerr, opts.diagnostic_format);
+}
+
+// Directives that only matter to control sections and the linker
+static bool isLinkageDirective(Directive directive) {
+    return directive == Directive::CSECT || directive == Directive::EXTDEF || directive == Directive::EXTREF;
+}
+
+// Split a comma separated EXTDEF or EXTREF operand into names
+static void splitNames(std::string_view list, std::vector<std::string_view>& names) {
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view name = list.substr(0, comma);
+        if (!name.empty())
+            names.push_back(name);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+    }
+}
+
+bool Assembler::operandAffectsLayout(std::string_view operation) const {
+    return directiveKind(operation) != Directive::NONE;
+}
+
+std::pair<int, int> Assembler::addressField(const LineRecord&) const {
+    // SIC instructions: opcode byte, then a 16-bit address
+    return {1, 4};
+}
+
+uint64_t Assembler::layoutKey(std::string_view text) const {
+    // Labels, operations and directive operands decide every location; the
+    // operands of instructions do not
+    uint64_t key = hashBytes("layout");
+    LineReader reader(text);
+    std::string_view line;
+    while (reader.next(line)) {
+        SourceLine tokens = splitLine(line);
+        if (tokens.labelled) {
+            key = hashBytes(tokens.label, key);
+            key = hashBytes(":", key);
+        }
+        if (tokens.operation.empty())
+            continue;
+        key = hashBytes(tokens.operation, key);
+        if (operandAffectsLayout(tokens.operation))
+            key = hashBytes(tokens.operand, key);
+        key = hashBytes("\n", key);
+        if (directiveKind(tokens.operation) == Directive::END)
+            break;
+    }
+    return key;
+}
+
+void Assembler::saveLayout(CachedLayout& layout) const {
+    layout.program_name = program_name;
+    layout.start_address = start_address;
+    layout.program_length = program_length;
+    for (int id = 0; id < blocks.size(); id++) {
+        layout.blocks.push_back(CachedLayout::Block{std::string(blocks.name(id)), blocks.startAddress(id),
+                                                    blocks.length(id), blocks.location(id)});
+    }
+    for (int id = 0; id < symtab.size(); id++) {
+        if (symtab.defined(id))
+            layout.symbols.push_back(CachedLayout::Symbol{std::string(symtab.name(id)), symtab.address(id), symtab.block(id)});
+    }
+    for (const LineRecord& record : program)
+        layout.lines.push_back(CachedLayout::Line{record.location, record.block});
+}
+
+bool Assembler::pass1Replay(std::string_view text, const CachedLayout& layout) {
+    // Restore the tables pass1 would have built
+    program_name = layout.program_name;
+    start_address = layout.start_address;
+    program_length = layout.program_length;
+    for (const CachedLayout::Block& block : layout.blocks)
+        blocks.restore(block.name, block.start_address, block.length, block.location);
+    for (const CachedLayout::Symbol& symbol : layout.symbols)
+        symtab.define(symtab.intern(symbol.name), symbol.address, symbol.block);
+
+    // Decode the lines again, taking every location from the layout
+    program.clear();
+    program.reserve(layout.lines.size());
+    LineReader reader(text);
+    std::string_view line;
+    std::string problem;
+    while (program.size() < layout.lines.size() && reader.next(line)) {
+        stats.lines++;
+        SourceLine tokens = splitLine(line);
+        if (opts.cross_reference && tokens.labelled) {
+            int id = symtab.find(tokens.label);
+            if (id != SymbolTable::npos)
+                xref.define(id, static_cast<int>(stats.lines));
+        }
+        if (tokens.operation.empty())
+            continue;
+        const CachedLayout::Line& cached = layout.lines[program.size()];
+        LineRecord record = decodeLine(tokens, cached.location, cached.block);
+        record.line = static_cast<int>(stats.lines);
+        if (isLinkageDirective(record.directive) || record.directive == Directive::MACRO ||
+            record.directive == Directive::LTORG || (record.directive == Directive::NONE && isLiteral(tokens.operand)))
+            return false;   // The layout does not record control sections, macro expansions or literal pools
+        // Instruction operands are not part of the layout key. One that pass1
+        // would reject makes this a miss, so the full pass reports it
+        if (record.directive != Directive::START && record.directive != Directive::END &&
+            record.directive != Directive::USE && addressTranslation(tokens, record, problem) < 0)
+            return false;
+        program.push_back(record);
+    }
+    return program.size() == layout.lines.size();
+}
+
+void Assembler::reset() {
+    symtab.clear();
+    blocks.clear();
+    program.clear();
+    program_name = "";
+    start_address = 0;
+    program_length = 0;
+    sections.clear();
+    linkable = false;
+    macros.clear();
+    literals.clear();
+    xref.clear();
+}
 
 bool Assembler::pass1(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) 
+    if (!source.open(filename)) 
         return error("Could not open file " + filename);
+    diags.begin(filename, source.text());
+    return pass1Buffer(source.text());
+}
 
-    // Create intermediate file
-    size_t dotPos = filename.find('.'); // Find first occurrence of '.'
-    std::string baseName = (dotPos == std::string::npos) ? filename : filename.substr(0, dotPos);
-    std::string intermediateFilename = baseName + ".intermediate";
-    std::ofstream intermediateFile(intermediateFilename);
-    if (!intermediateFile.is_open()) 
-        return error("Could not create intermediate file " + intermediateFilename);
-    
-    std::string line;
-    int start_loc = 0, max_block_num = 0;
-    start_address = "0";
+bool Assembler::pass1Parallel(std::string_view text, bool& ok) {
+    // Each chunk of the source is sized on its own. A chunk does not know
+    // which block is current where it starts, so it numbers blocks locally:
+    // local block 0 is the inherited one, the others are named by USE. Lines
+    // are placed at an offset into what their chunk adds to their local
+    // block. A prefix sum over the chunks then gives every local block its
+    // absolute base, and labels are defined in source order.
+    struct PendingLine {
+        SourceLine tokens;
+        std::string_view symbolName;    // Operand symbol, interned at merge time
+        LineRecord record;              // Chunk-local block and offset
+        bool failed = false;            // Only the label counts; the problem is in the chunk's list
+    };
+    struct Chunk {
+        std::string_view text;
+        std::vector<PendingLine> lines;
+        BlockTable blocks;              // Local blocks counting from 0; [0] is inherited
+        int current = 0;                // Local block current at the end of the chunk
+        size_t lines_read = 0, optab_lookups = 0;
+        int program_length = 0;
+        int starts = 0;                 // START directives seen
+        bool leading_start = false;     // START was the chunk's first line
+        int start_loc = 0;
+        bool serial = false;            // Saw CSECT, EXTDEF, EXTREF, MACRO, LTORG or a literal
+        bool ended = false;             // Stopped at END
+        std::vector<std::pair<std::string_view, std::string>> problems;   // Token and message, reported at merge
+    };
+
+    size_t chunkCount = opts.threads * 4;
+    std::vector<Chunk> chunks(chunkCount);
+    size_t begin = 0;
+    for (size_t c = 0; c < chunkCount; c++) {
+        // Cut after a newline so no line is split between chunks
+        size_t end = c + 1 == chunkCount ? text.size() : std::max(begin, text.size() * (c + 1) / chunkCount);
+        if (end < text.size()) {
+            end = text.find('\n', end);
+            end = end == std::string_view::npos ? text.size() : end + 1;
+        }
+        chunks[c].text = text.substr(begin, end - begin);
+        begin = end;
+    }
+
+    ThreadPool pool(opts.threads);
+    for (Chunk& chunk : chunks) {
+        pool.submit([&] {
+            LineReader reader(chunk.text);
+            std::string_view line;
+            std::string problem;
+            chunk.blocks.use({}, 0);
+            while (reader.next(line)) {
+                chunk.lines_read++;
+                PendingLine pending{splitLine(line), {}, {}};
+                const SourceLine& tokens = pending.tokens;
+                if (tokens.operation.empty()) {
+                    if (tokens.labelled) {
+                        pending.record = LineRecord{chunk.blocks.location(chunk.current), chunk.current, -1,
+                                                    Directive::NONE, {}, SymbolTable::npos, false};
+                        pending.record.line = static_cast<int>(chunk.lines_read);
+                        chunk.lines.push_back(pending);
+                    }
+                    continue;
+                }
+                LineRecord& record = pending.record;
+                record = decodeOperation(optab, tokens, chunk.blocks.location(chunk.current), chunk.current, pending.symbolName);
+                record.line = static_cast<int>(chunk.lines_read);   // Within the chunk until the merge
+                if (record.directive == Directive::NONE)
+                    chunk.optab_lookups++;
+
+                if (record.directive == Directive::START) {
+                    chunk.starts++;
+                    chunk.leading_start = chunk.lines.empty();
+                    std::string_view operand = tokens.operand;
+                    if (!operand.empty()) {
+                        auto [end, status] = std::from_chars(operand.data(), operand.data() + operand.size(), chunk.start_loc, 16);
+                        if (status != std::errc() || end == operand.data()) {
+                            pending.failed = true;
+                            chunk.problems.emplace_back(operand, "Invalid START address: " + std::string(operand));
+                        }
+                    }
+                } else if (record.directive == Directive::USE) {
+                    std::string_view name = tokens.operand.empty() ? "DEFAULT" : tokens.operand;
+                    chunk.current = chunk.blocks.use(name, 0);
+                    record.block = chunk.current;
+                    record.location = chunk.blocks.location(chunk.current);
+                } else if (record.directive == Directive::END) {
+                    chunk.ended = true;
+                } else if (isLinkageDirective(record.directive) || record.directive == Directive::MACRO ||
+                           record.directive == Directive::LTORG || isLiteral(tokens.operand)) {
+                    chunk.serial = true;
+                    return;
+                } else {
+                    int instruction_size = addressTranslation(tokens, record, problem);
+                    if (instruction_size < 0) {
+                        pending.failed = true;
+                        chunk.problems.emplace_back(tokens.operation, std::move(problem));
+                    } else {
+                        chunk.blocks.location(chunk.current) += instruction_size;
+                        chunk.program_length += instruction_size;
+                    }
+                }
+                chunk.lines.push_back(pending);
+                if (chunk.ended)
+                    return;
+            }
+        });
+    }
+    pool.wait();
+
+    // Only chunks up to the one holding END count
+    size_t used = 0;
+    int starts = 0;
+    while (used < chunkCount) {
+        const Chunk& chunk = chunks[used++];
+        starts += chunk.starts;
+        if (chunk.serial)
+            return false;   // Control sections, macros and literals are handled by the serial pass
+        if (chunk.ended)
+            break;
+    }
+    // START resets the location counter, so it can only come first
+    if (starts > 1 || (starts == 1 && !chunks[0].leading_start))
+        return false;
+
+    int start_loc = starts == 1 ? chunks[0].start_loc : 0;
+    start_address = start_loc;
+    program_name = "";
+    program.clear();
+    blocks.use("DEFAULT", start_loc);
+
+    int current_block_num = 0, size_pg = 0;
+    for (size_t c = 0; c < used; c++) {
+        const Chunk& chunk = chunks[c];
+        int first_line = static_cast<int>(stats.lines);    // Lines of the chunks before
+        stats.lines += chunk.lines_read;
+        stats.optab_lookups += chunk.optab_lookups;
+        size_pg += chunk.program_length;
+
+        // Number the chunk's blocks globally, creating new ones in the order
+        // the serial pass would, and reserve each one's share of its block.
+        // Lines of the inherited block precede any USE, so it goes first.
+        std::vector<int> global(chunk.blocks.size()), base(chunk.blocks.size());
+        global[0] = current_block_num;
+        for (int k = 1; k < chunk.blocks.size(); k++) {
+            global[k] = blocks.use(chunk.blocks.name(k), start_loc);
+            stats.block_lookups++;
+        }
+        for (int k = 0; k < chunk.blocks.size(); k++) {
+            base[k] = blocks.location(global[k]);
+            blocks.location(global[k]) += chunk.blocks.location(k);
+        }
+        current_block_num = global[chunk.current];
+
+        for (size_t i = 0; i < chunk.lines.size(); i++) {
+            const PendingLine& pending = chunk.lines[i];
+            LineRecord record = pending.record;
+            record.location += base[record.block];
+            record.block = global[record.block];
+            record.line += first_line;
+            if (pending.tokens.labelled) {
+                defineLabel(symtab.intern(pending.tokens.label), pending.tokens.label, record.location, record.block, record.line);
+                stats.symbol_lookups++;
+            }
+            if (pending.tokens.operation.empty() || pending.failed)
+                continue;
+            if (!pending.symbolName.empty()) {
+                record.symbol = symtab.intern(pending.symbolName);
+                stats.symbol_lookups++;
+            }
+            if (record.directive == Directive::START && !pending.tokens.operand.empty() && !pending.tokens.label.empty())
+                program_name = pending.tokens.label;
+            program.push_back(record);
+            if (record.directive == Directive::END)
+                blocks.finish(start_loc);
+        }
+        for (const auto& [at, message] : chunk.problems)
+            diags.error(message, 0, at);
+    }
+    if (!chunks[used - 1].ended)
+        diags.warning("Missing END directive");
+    program_length = size_pg;
+    ok = diags.errors() == 0;
+    return true;
+}
+
+bool Assembler::pass1Buffer(std::string_view text) {
+    macros.clear();
+    literals.clear();
+    if (opts.threads > 1 && text.size() >= PARALLEL_PASS1_MIN_BYTES) {
+        bool ok;
+        if (pass1Parallel(text, ok)) {
+            relax();
+            return ok;
+        }
+    }
+
+    // Macro definitions are taken out and invocations expanded before any
+    // line is sized, so the rest of pass1 only sees plain lines
+    MacroReader reader(text, macros, diags);
+    SourceLine tokens;
+    std::string problem;
+    int start_loc = 0, line = 0;
+    bool ended = false;
+    start_address = 0;
     program_name = "";
     
     int current_block_num = 0; // Current block (default is 0)
-    int instruction_size, size_pg  = std::stoi(start_address, nullptr, 16);
+    int current_section = 0;
+    int instruction_size, size_pg  = 0;
+    program.clear();
+    sections.assign(1, ControlSection());
+    linkable = false;
     
-    // Add default block (block 0) to block table
-    block_table.add("0", "name", "DEFAULT");
-    block_table.add("0", "start_address", "0");
-    block_table.add("0", "length", "0");
-    
-    while (std::getline(file, line)) {
-        // Skip empty lines
-        if (line.empty()) {
-            continue;
-        }
+    // Default block (block 0); START moves its location counter
+    blocks.use("DEFAULT", 0);
 
-        // Trim leading whitespace
-        size_t first_non_space = line.find_first_not_of(" \t");
-        if (first_non_space == std::string::npos) {
-            continue;  // Line is all whitespace
+    // Place the open literal pool at the current location as BYTE and WORD
+    // lines, so pass2 assembles the constants like any other
+    auto placeLiterals = [&]() {
+        for (int id : literals.pending()) {
+            Directive kind = literals.isWord(id) ? Directive::WORD : Directive::BYTE;
+            SourceLine constant{false, {}, directiveName(kind), literals.text(id)};
+            LineRecord record{blocks.location(current_block_num), current_block_num, -1, kind, literals.text(id), SymbolTable::npos, false};
+            record.line = line;
+            instruction_size = addressTranslation(constant, record, problem);
+            if (instruction_size < 0) {
+                lineError(record, problem);
+                continue;
+            }
+            literals.place(id, record.location, current_block_num);
+            blocks.location(current_block_num) += instruction_size;
+            size_pg += instruction_size;
+            program.push_back(record);
         }
-        line = line.substr(first_non_space);
-
-        // Original line for intermediate file
-        std::string originalLine = line;
-        std::string symbol = "";
+        literals.closePool();
+    };
+    
+    // Lines are lexed once; all tokens are views into the source text or
+    // into an expansion, both of which outlive pass2
+    // A bad line is reported and left out, and pass1 goes on with the next
+    while (reader.next(tokens)) {
+        std::string_view symbol = tokens.label;
+        line = static_cast<int>(reader.linesRead());
 
-        // Check if there's a symbol in the line (ending with ':')
-        size_t colon_pos = line.find(':');
-        if (colon_pos != std::string::npos) {
-            // Extract symbol (and trim any whitespace)
-            symbol = line.substr(0, colon_pos);
-            symbol.erase(symbol.find_last_not_of(" \t") + 1);  // Remove trailing spaces
-            
-            // Convert current block's location counter to a 4-digit hex string
-            std::stringstream hexLoc;
-            hexLoc << std::uppercase << std::hex << std::setw(4) << std::setfill('0') << loc_counter[current_block_num];
-            
-            // Add symbol to symbol table with current location counter and block number
-            symtab.add(symbol, "value", hexLoc.str());
-            symtab.add(symbol, "block", std::to_string(current_block_num));
-            
-            // Remove the symbol part from the line for further processing
-            line = line.substr(colon_pos + 1);
-            // Trim leading whitespace again
-            first_non_space = line.find_first_not_of(" \t");
-            if (first_non_space == std::string::npos) {
-                continue;  // No operation after symbol
+        // CSECT starts a new section at location 0; its label is the section name
+        if (directiveKind(tokens.operation) == Directive::CSECT) {
+            if (blocks.size() > 1) {
+                diags.error("USE blocks cannot be combined with CSECT", line, tokens.operation);
+                continue;
             }
-            line = line.substr(first_non_space);
+            placeLiterals();    // A section's literals stay in the section
+            sections.back().length = blocks.location(current_block_num) - sections.back().start_address;
+            sections.push_back(ControlSection{std::string(symbol), 0, 0, {}, {}});
+            current_section++;
+            blocks.location(current_block_num) = 0;
+            linkable = true;
+        }
+
+        // Add symbol to symbol table with current location counter and block number
+        if (tokens.labelled) {
+            defineLabel(symtab.intern(symbol, current_section), symbol, blocks.location(current_block_num), current_block_num, line);
+            stats.symbol_lookups++;
         }
 
-        // At this point, line contains operation (and possibly operands)
         // Parse operation and update location counter
-        std::string operation;
-        std::string operand = "";
-        std::istringstream iss(line);
-        iss >> operation;
-        
+        std::string_view operation = tokens.operation;
+        std::string_view operand = tokens.operand;
         if (operation.empty()) {
             continue;  // No operation found
         }
 
-        // Get the operand if present
-        std::getline(iss >> std::ws, operand);
-        
-        int current_loc = loc_counter[current_block_num];  // Store current location for intermediate file
+        // Decode the operation once so pass2 never has to look at the text again
+        LineRecord record = decodeLine(tokens, blocks.location(current_block_num), current_block_num, current_section);
+        record.line = line;
         
+        if (record.directive == Directive::CSECT) {
+            program.push_back(record);
+            continue;
+        }
+        if (record.directive == Directive::EXTDEF || record.directive == Directive::EXTREF) {
+            ControlSection& section = sections.back();
+            if (record.directive == Directive::EXTDEF) {
+                splitNames(operand, section.definitions);
+            } else {
+                size_t first = section.references.size();
+                splitNames(operand, section.references);
+                for (size_t i = first; i < section.references.size(); i++)
+                    symtab.markExternal(symtab.intern(section.references[i], current_section));
+            }
+            linkable = true;
+            program.push_back(record);
+            continue;
+        }
+
         // Check for START directive
-        if (operation == "START") {
-            // Just copy the original line to the intermediate file
+        if (record.directive == Directive::START) {
             if (!operand.empty()) {
-                start_address = operand;
-                start_loc = std::stoi(operand, nullptr, 16); // Convert hex string to int
-                loc_counter[current_block_num] = start_loc; // Initialize default block's loc counter
+                auto [end, status] = std::from_chars(operand.data(), operand.data() + operand.size(), start_loc, 16);
+                if (status != std::errc() || end == operand.data()) {
+                    lineError(record, "Invalid START address: " + std::string(operand));
+                    continue;
+                }
+                start_address = start_loc;
+                blocks.location(current_block_num) = start_loc; // Initialize default block's loc counter
             }
             if (!operand.empty() && !symbol.empty()){
                 program_name = symbol;
             }
-                
-            intermediateFile << originalLine << std::endl;
+            sections.back().name = program_name;
+            sections.back().start_address = start_loc;
+            record.location = blocks.location(current_block_num);
+            program.push_back(record);
             continue;  // Skip to next line
         }
         
         // Handle USE directive for block management
-        if (operation == "USE") {
-            // If operand is empty, switch to default block
-            if (operand.empty() || operand == "DEFAULT") {
-                current_block_num = 0;
-            } else {
-                // Check if this block already exists in the block table
-                bool block_exists = false;
-                for (int i = 0; i <= max_block_num; i++) {
-                    std::string block_name;
-                    try {
-                        block_name = block_table.value(std::to_string(i), "name");
-                        if (block_name == operand) {
-                            current_block_num = i;
-                            block_exists = true;
-                            break;
-                        }
-                    } catch (...) {
-                        // Block doesn't exist, continue checking
-                    }
-                }
-                
-                // If block doesn't exist, create a new one
-                if (!block_exists) {
-                    int new_block_num = max_block_num+1;
-                    current_block_num = new_block_num;
-                    block_table.add(std::to_string(new_block_num), "name", operand);
-                    block_table.add(std::to_string(new_block_num), "start_address", "0"); // Temporary, will update later
-                    block_table.add(std::to_string(new_block_num), "length", "0"); // Temporary, will update later
-                    
-                    // Initialize the new block's location counter to the same as START
-                    loc_counter[new_block_num] = start_loc;
-                    current_block_num = new_block_num;
-                    max_block_num = new_block_num;
-                }
+        if (record.directive == Directive::USE) {
+            if (sections.size() > 1) {
+                diags.error("USE blocks cannot be combined with CSECT", line, operation);
+                continue;
             }
+            // An empty operand switches back to the default block; a new
+            // block's location counter starts where START put the program
+            current_block_num = blocks.use(operand.empty() ? "DEFAULT" : operand, start_loc);
+            stats.block_lookups++;
             
-            // Write USE directive to intermediate file 
-            intermediateFile << "XXXX" << " " << operation << " " << operand << std::endl;
+            record.block = current_block_num;
+            record.location = blocks.location(current_block_num);
+            program.push_back(record);
             continue;  // Skip to next line
         }
         
-        if (operation == "END") {
-            // Calculate program length as sum of all block lengths
-            int total_length = 0;
-            int next_block_addr = start_loc;
-            
-            // First, calculate the length of each block
-            for (int i = 0; i <= max_block_num; i++) {
-                int block_length = 0;
-                
-                // If block has instructions, calculate its length
-                if (loc_counter.find(i) != loc_counter.end()) {
-                    block_length = loc_counter[i] - start_loc ;
-                }
-                
-                // Convert length to hex string
-                std::stringstream hexLength;
-                hexLength << std::uppercase << std::hex << std::setw(4) << std::setfill('0') << block_length;
-                block_table.add(std::to_string(i), "length", hexLength.str());
-                
-                // Set start addresses for each block
-                std::stringstream hexStart;
-                hexStart << std::uppercase << std::hex << std::setw(4) << std::setfill('0') << next_block_addr;
-                block_table.add(std::to_string(i), "start_address", hexStart.str());
-                
-                // Next block starts after this one
-                next_block_addr += block_length;
-                
-                // Add to total program length
-                total_length += block_length;
-            }
-    
-            std::stringstream newstream;
-            newstream << std::uppercase << std::hex << std::setw(4) << std::setfill('0') << loc_counter[current_block_num];
-            std::string temp = newstream.str();
-            intermediateFile << temp << " " << operation << " " << operand << std::endl;
+        if (record.directive == Directive::LTORG) {
+            placeLiterals();
+            continue;
+        }
+        if (record.directive == Directive::END) {
+            placeLiterals();
+            record.location = blocks.location(current_block_num);
+            sections.back().length = blocks.location(current_block_num) - sections.back().start_address;
+            blocks.finish(start_loc);
+            program.push_back(record);
+            ended = true;
             break; // Stop processing at END directive
         }
+        if (record.directive == Directive::NONE && isLiteral(operand)) {
+            std::string_view literal = operand.substr(1, operand.find(",X") - 1);
+            if (!literals.add(literal, record.literal)) {
+                lineError(record, "Invalid literal: " + std::string(operand));
+                continue;
+            }
+        }
         // Update location counter based on operation
-        try {
-            // Call the address translation function to get the size of the instruction
-            instruction_size = addressTranslation(operation, line);
-            loc_counter[current_block_num] += instruction_size;
-            
-            // Format: <address> <opcode> <operand> <block_num>
-            intermediateFile << std::hex << std::setw(4) << std::setfill('0') << current_loc << " "
-                              << operation << " " << operand << std::endl;
-        } catch (const std::exception& e){
-            return error(e.what());  
+        instruction_size = addressTranslation(tokens, record, problem);
+        if (instruction_size < 0) {
+            diags.error(problem, line, operation);
+            continue;
         }
+        blocks.location(current_block_num) += instruction_size;
+        program.push_back(record);
         size_pg += instruction_size;
     }
-    std::stringstream hexStream;
-    hexStream << std::uppercase << std::hex << std::setw(4) << std::setfill('0') << size_pg;
-    program_length = hexStream.str();
+    if (!ended && !reader.failed())
+        diags.warning("Missing END directive");
+    stats.lines += reader.linesRead();
+    stats.macro_expansions = macros.expansions();
+    stats.macro_hits = macros.memoHits();
+    program_length = size_pg;
+    relax();
+    return diags.errors() == 0;
+}
+
+std::tuple<int, bool> Assembler::encodeLine(const LineRecord& record, const std::vector<int>& block_offset,
+                                            std::vector<unsigned char>& objectCode, size_t& lookups, std::string& problem) {
+    // START, END and USE directives produce no object code
+    if (record.directive == Directive::START || record.directive == Directive::END || record.directive == Directive::USE ||
+        record.directive == Directive::LTORG || isLinkageDirective(record.directive)) {
+        return std::make_tuple(0, false);
+    }
     
-    file.close();
-    intermediateFile.close();
-    return true;
+    // Absolute operand address: symbol value relocated by its block's start
+    int operandAddress = SymbolTable::undefined;
+    if (record.symbol != SymbolTable::npos && symtab.external(record.symbol)) {
+        operandAddress = 0;     // Filled in by the linker from a modification record
+    } else if (record.symbol != SymbolTable::npos && symtab.defined(record.symbol)) {
+        lookups++;
+        operandAddress = symtab.address(record.symbol) + block_offset[symtab.block(record.symbol)];
+    } else if (record.literal >= 0) {
+        operandAddress = literals.location(record.literal) + block_offset[literals.block(record.literal)];
+    }
+    // Relative operands need the line's own address in the program
+    LineRecord placed = record;
+    placed.location += block_offset[record.block];
+    return generateObjectCode(placed, operandAddress, objectCode, problem);
 }
 
-bool Assembler::pass2(const std::string& filename) {
-    // Open the intermediate file
-    size_t dotPos = filename.find('.'); // Find first occurrence of '.'
-    std::string baseName = (dotPos == std::string::npos) ? filename : filename.substr(0, dotPos);
-    std::string intermediateFilename = baseName + ".intermediate";
-    std::ifstream intermediateFile(intermediateFilename);
-    if (!intermediateFile.is_open()) {
-        return error("Could not open intermediate file " + intermediateFilename);
+bool Assembler::pass2Parallel(const std::vector<int>& block_offset,
+                              const std::function<void(const LineRecord&, const unsigned char*, size_t, bool)>& emit) {
+    // Every line's address and every symbol are final, so lines can be
+    // encoded independently. Each chunk collects its object code in its own
+    // buffer; the text records are then cut serially, in program order, so
+    // the output is identical to the serial path.
+    struct LineCode {
+        size_t record;              // Index of the line in program
+        size_t offset;              // Start of the line's bytes in the chunk buffer
+        size_t size;
+        bool reserve;
+    };
+    struct Chunk {
+        size_t first, last;         // Record range [first, last)
+        std::vector<unsigned char> bytes;
+        std::vector<LineCode> codes;
+        size_t lookups = 0;
+        std::vector<std::pair<size_t, std::string>> problems;   // Record and message, reported at merge
+    };
+
+    size_t chunkCount = std::min<size_t>(opts.threads * 4, program.size());
+    std::vector<Chunk> chunks(chunkCount);
+    ThreadPool pool(opts.threads);
+    for (size_t c = 0; c < chunkCount; c++) {
+        chunks[c].first = program.size() * c / chunkCount;
+        chunks[c].last = program.size() * (c + 1) / chunkCount;
+        pool.submit([&, c] {
+            Chunk& chunk = chunks[c];
+            chunk.codes.reserve(chunk.last - chunk.first);
+            std::vector<unsigned char> objectCode;
+            std::string problem;
+            for (size_t i = chunk.first; i < chunk.last; i++) {
+                objectCode.clear();
+                auto [length, reserve] = encodeLine(program[i], block_offset, objectCode, chunk.lookups, problem);
+                if (length < 0) {
+                    chunk.problems.emplace_back(i, std::move(problem));
+                    continue;
+                }
+                chunk.codes.push_back(LineCode{i, chunk.bytes.size(), objectCode.size(), reserve});
+                chunk.bytes.insert(chunk.bytes.end(), objectCode.begin(), objectCode.end());
+            }
+        });
     }
+    pool.wait();
 
-    // Create the object file
+    // Merge in order; bad lines were left out, as the serial path leaves them
+    bool ok = true;
+    for (const Chunk& chunk : chunks) {
+        stats.symbol_lookups += chunk.lookups;
+        for (const LineCode& code : chunk.codes)
+            emit(program[code.record], chunk.bytes.data() + code.offset, code.size, code.reserve);
+        for (const auto& [i, message] : chunk.problems)
+            ok = lineError(program[i], message);
+    }
+    return ok;
+}
+
+// Write the object records of the decoded program; image, if given, also
+// receives the object code for the binary format
+bool Assembler::generateObject(ObjectWriter& writer, ObjectProgram* image) {
+    if (linkable && image)
+        return error("The binary format holds one absolute program; use the text format for control sections");
+
+    // Offset of each block from the program start, computed once for every operand
+    std::vector<int> block_offset(blocks.size());
+    for (int i = 0; i < blocks.size(); i++)
+        block_offset[i] = blocks.startAddress(i) - start_address;
+
+    // Every symbol's final address and every line that names one, for the
+    // cross-reference; the records already hold the symbol ids
+    if (opts.cross_reference) {
+        for (int id = 0; id < symtab.size(); id++) {
+            if (symtab.defined(id))
+                xref.place(id, symtab.address(id) + block_offset[symtab.block(id)]);
+        }
+        for (const LineRecord& record : program) {
+            if (record.symbol == SymbolTable::npos)
+                continue;
+            uint32_t flags = (record.indexed ? CrossReference::INDEXED : 0) |
+                             (record.prefix == '#' ? CrossReference::IMMEDIATE : 0) |
+                             (record.prefix == '@' ? CrossReference::INDIRECT : 0);
+            xref.use(record.symbol, record.line, record.location + block_offset[record.block], flags);
+        }
+    }
+
+    int text_block = 0, text_end = 0;  // Block and address the open text record continues at
+    bool ok = true;
+
+    // Every control section is written as a program of its own: H, D and R
+    // records, its text records, then M records and E. Addresses in its
+    // instructions are relative to the section, so each one gets a
+    // modification record naming the external symbol or the section itself.
+    struct Modification {
+        int address;
+        int half_bytes;
+        std::string_view symbol;
+    };
+    std::vector<Modification> modifications;
+    size_t section = 0;
+    auto beginSection = [&]() {
+        const ControlSection& current = sections[section];
+        writer.header(current.name, current.start_address, current.length);
+        std::vector<std::pair<std::string_view, int>> definitions;
+        for (std::string_view name : current.definitions) {
+            int id = symtab.find(name, static_cast<int>(section));
+            stats.symbol_lookups++;
+            if (id == SymbolTable::npos || !symtab.defined(id)) {
+                ok = diags.error("Undefined EXTDEF symbol: " + std::string(name), 0, name);
+                continue;
+            }
+            definitions.emplace_back(name, symtab.address(id) + block_offset[symtab.block(id)]);
+        }
+        writer.definitions(definitions);
+        writer.references(current.references);
+    };
+    auto endSection = [&]() {
+        writer.flushText();
+        for (const Modification& modification : modifications)
+            writer.modification(modification.address, modification.half_bytes, modification.symbol);
+        modifications.clear();
+        // Only the first section gives the entry point
+        if (section == 0)
+            writer.end(start_address);
+        else
+            writer.end();
+    };
+
+    // Header record: name padded to 6 characters, start and length as 6 hex digits
+    if (linkable) {
+        beginSection();
+    } else {
+        writer.header(program_name, start_address, program_length);
+    }
+
+    // Add one line's object code to the text records at its address in the
+    // program. A record ends at a reservation, at a line of another block
+    // and when the line would make it too long; longer constants are split
+    auto emit = [&](const LineRecord& record, const unsigned char* objectCode, size_t size, bool isReserveDirective) {
+        if (isReserveDirective) {
+            writer.flushText();
+            return;
+        }
+        if (size == 0)
+            return;
+
+        int address = record.location + block_offset[record.block];
+        if (!writer.textEmpty() && (record.block != text_block || address != text_end))
+            writer.flushText();
+        size_t written = 0;
+        while (written < size) {
+            size_t count = size - written;
+            if (writer.textLength() + count > ObjectWriter::MAX_TEXT_RECORD_LENGTH) {
+                writer.flushText();
+                count = std::min<size_t>(count, ObjectWriter::MAX_TEXT_RECORD_LENGTH);
+            }
+            if (writer.textEmpty()) {
+                writer.startText(address + static_cast<int>(written));
+            }
+            writer.addText(objectCode + written, count);
+            if (image) {
+                image->addBytes(address + static_cast<int>(written), objectCode + written, count);
+            }
+            written += count;
+        }
+        text_block = record.block;
+        text_end = address + static_cast<int>(size);
+        stats.object_bytes += size;
+    };
+
+    if (opts.threads > 1 && program.size() >= PARALLEL_PASS2_MIN_LINES && !linkable) {
+        ok = pass2Parallel(block_offset, emit);
+    } else {
+        // Generate text records from the lines decoded by pass1; a line that
+        // cannot be encoded is reported and left out
+        std::vector<unsigned char> objectCode; // Reused for every line
+        std::string problem;
+        for (const LineRecord& record : program) {
+            if (record.directive == Directive::CSECT) {
+                endSection();
+                section++;
+                beginSection();
+                continue;
+            }
+            objectCode.clear();
+            auto [objectCodeLength, isReserveDirective] = encodeLine(record, block_offset, objectCode, stats.symbol_lookups, problem);
+            if (objectCodeLength < 0) {
+                ok = lineError(record, problem);
+                continue;
+            }
+            if (linkable && record.directive == Directive::NONE &&
+                (record.symbol != SymbolTable::npos || record.literal >= 0)) {
+                auto [offset, halfBytes] = addressField(record);
+                bool external = record.symbol != SymbolTable::npos && symtab.external(record.symbol);
+                std::string_view symbol = external ? symtab.name(record.symbol) : sections[section].name;
+                if (halfBytes > 0)
+                    modifications.push_back(Modification{record.location + block_offset[record.block] + offset, halfBytes, symbol});
+            }
+            emit(record, objectCode.data(), objectCode.size(), isReserveDirective);
+        }
+    }
     
+    // Write the final text record and the end record with start address
+    if (linkable)
+        endSection();
+    else
+        writer.end(start_address);
+    stats.text_records = writer.textRecords();
+    if (image) {
+        image->flatten();   // Blocks were emitted in program order, not address order
+        image->name = program_name;
+        image->start_address = start_address;
+        image->program_length = program_length;
+        image->entry_address = start_address;
+    }
+    return ok;
+}
+
+bool Assembler::pass2(const std::string& filename) {
+    // Create the object file
+    std::string baseName = outputBase(filename);
     std::string objectFilename = baseName + ".obj";
-    std::ofstream objectFile(objectFilename);
-    if (!objectFile.is_open()) {
+    std::string binaryFilename = baseName + ".sicb";
+    // After pass1 errors the program is still encoded, for the errors only
+    // pass2 finds, but no object file is written
+    bool clean = diags.errors() == 0;
+    bool textOutput = clean && opts.object_format != ObjectFormat::BINARY;
+    bool binaryOutput = clean && opts.object_format != ObjectFormat::TEXT;
+    ObjectWriter writer;
+    if (!textOutput) {
+        writer.discard();
+    } else if (!writer.open(objectFilename)) {
         return error("Could not create object file " + objectFilename);
     }
+    ObjectProgram image; // Collected only for the binary format
+    bool ok = generateObject(writer, binaryOutput ? &image : nullptr) && clean;
+    if (!writer.close()) {
+        return error("Could not write object file " + objectFilename);
+    }
+    if (!ok) {
+        // An object file left from an earlier run must not pass for this one
+        std::error_code ignored;
+        std::filesystem::remove(objectFilename, ignored);
+        std::filesystem::remove(binaryFilename, ignored);
+        return false;
+    }
+    if (binaryOutput && !writeBinaryObject(binaryFilename, image))
+        return false;
+    return true;
+}
+
 
-    // Ensure start_address is 6 characters
-    std::string paddedStartAddress = start_address;
-    while (paddedStartAddress.length() < 6) {
-        paddedStartAddress = "0" + paddedStartAddress;
+bool Assembler::writeIntermediate(const std::string& filename) const {
+    std::ofstream intermediateFile(filename);
+    if (!intermediateFile.is_open()) 
+        return error("Could not create intermediate file " + filename);
+
+    // Format: <address> <block_num> <opcode or directive> <operand>
+    for (const LineRecord& record : program) {
+        intermediateFile << std::uppercase << std::hex << std::setw(4) << std::setfill('0') << record.location << " "
+                         << std::dec << record.block << " ";
+        if (record.directive == Directive::NONE)
+            intermediateFile << std::hex << std::setw(2) << record.opcode;
+        else
+            intermediateFile << directiveName(record.directive);
+        intermediateFile << " " << record.operand << '\n';
     }
+    return true;
+}
+
+bool Assembler::assemble(const std::string& filename) {
+    using clock = std::chrono::steady_clock;
+    auto elapsed = [](clock::time_point from) {
+        return std::chrono::duration<double>(clock::now() - from).count();
+    };
+    stats = AssemblyStats();
+    size_t allocations = allocationCount(), allocated = allocatedBytes();
+    auto started = clock::now();
 
-    // Ensure program_length is 6 characters
-    std::string paddedProgramLength = program_length;
-    while (paddedProgramLength.length() < 6) {
-        paddedProgramLength = "0" + paddedProgramLength;
+    std::string baseName = outputBase(filename);
+    if (!source.open(filename)) 
+        return error("Could not open file " + filename);
+    diags.begin(filename, source.text());
+
+    // With a cache, an unchanged source skips assembly entirely and a source
+    // whose layout is unchanged only reruns pass2
+    std::unique_ptr<AssemblyCache> cache;
+    std::vector<std::string> outputs;
+    if (opts.dumps == DumpFormat::TEXT)
+        outputs = {".symbol.dump", ".block.dump"};
+    else if (opts.dumps == DumpFormat::SNAPSHOT)
+        outputs.push_back(".snapshot");
+    if (opts.cross_reference)
+        outputs.push_back(".xref");
+    if (opts.object_format != ObjectFormat::BINARY)
+        outputs.push_back(".obj");
+    if (opts.object_format != ObjectFormat::TEXT)
+        outputs.push_back(".sicb");
+    uint64_t sourceKey = 0, layoutHash = 0;
+    CachedLayout layout;
+    bool ok;
+    if (!opts.cache_dir.empty() && !opts.intermediate) {
+        cache = std::make_unique<AssemblyCache>(opts.cache_dir);
+        // Results depend on the backend and its opcode table as much as on the source
+        uint64_t optabKey = hashBytes(typeid(*this).name());
+        for (int id = 0; id < optab.size(); id++) {
+            optabKey = hashBytes(optab.mnemonic(id), optabKey);
+            char entry[] = {static_cast<char>(optab.value(id)), static_cast<char>(optab.format(id))};
+            optabKey = hashBytes(std::string_view(entry, 2), optabKey);
+        }
+        sourceKey = hashBytes(source.text(), optabKey);
+        if (cache->fetchOutputs(sourceKey, baseName, outputs)) {
+            reportDiagnostics();    // Only clean results are cached
+            stats.cache_hits++;
+            stats.total_seconds = elapsed(started);
+            stats.allocations = allocationCount() - allocations;
+            stats.allocated_bytes = allocatedBytes() - allocated;
+            return true;
+        }
+        layoutHash = layoutKey(source.text()) ^ optabKey;
     }
 
-    // Write header record - ensure program_name is exactly 6 characters
-    std::string paddedProgramName = program_name;
-    if (paddedProgramName.empty()) {
-        paddedProgramName = "      "; // 6 spaces if empty
+    // Opening and hashing the source count towards the total, not pass1
+    auto phase = clock::now();
+    if (cache && sizesAreLocal() && cache->loadLayout(layoutHash, layout) && pass1Replay(source.text(), layout)) {
+        stats.layout_hits++;
+        ok = true;
     } else {
-        // Pad or truncate to exactly 6 characters
-        paddedProgramName = std::string(paddedProgramName, 0, 6);
-        if (paddedProgramName.length() < 6) {
-            paddedProgramName.append(6 - paddedProgramName.length(), ' ');
+        reset();
+        stats.lines = 0;    // A replay that missed may have counted some
+        ok = pass1Buffer(source.text());
+        if (cache && ok && diags.all().empty() && sizesAreLocal() && !linkable && macros.empty() && literals.size() == 0) {
+            saveLayout(layout);
+            cache->storeLayout(layoutHash, layout);
         }
     }
-    
-    objectFile << "H " << paddedProgramName << " " 
-               << paddedStartAddress << " " << paddedProgramLength << std::endl;
-
-    // Variables for text record
-    std::string currentTextRecord = "";
-    std::string block_number;
-    std::string textStartAddress = "";
-    int textRecordLength = 0;
-    int track_length = std::stoi(start_address, nullptr, 16);
-    const int MAX_TEXT_RECORD_LENGTH = 30; // Maximum bytes per text record (60 hex chars)
-    bool firstObjectCodeInRecord = true; // Track if this is the first object code in the current record
+    stats.pass1_seconds = elapsed(phase);
+    stats.records = program.size();
+    stats.blocks = blocks.size();
+    for (int id = 0; id < symtab.size(); id++)
+        stats.symbols += symtab.defined(id) ? 1 : 0;
+
+    if (opts.intermediate)
+        writeIntermediate(baseName + ".intermediate");
+    phase = clock::now();
+    if (opts.dumps == DumpFormat::TEXT) {
+        symtab.dump(baseName + ".symbol.dump");
+        blocks.dump(baseName + ".block.dump");
+    } else if (opts.dumps == DumpFormat::SNAPSHOT) {
+        writeSnapshot(baseName + ".snapshot", symtab, blocks);
+    }
+    stats.dump_seconds = elapsed(phase);
 
+    phase = clock::now();
+    ok = pass2(filename) && ok;
+    if (ok && opts.cross_reference)
+        ok = writeCrossReference(baseName + ".xref", xref, symtab);
+    stats.pass2_seconds = elapsed(phase);
+    if (cache && ok && diags.all().empty())
+        cache->storeOutputs(sourceKey, baseName, outputs);
+    reportDiagnostics();
+
+    stats.total_seconds = elapsed(started);
+    stats.allocations = allocationCount() - allocations;
+    stats.allocated_bytes = allocatedBytes() - allocated;
+    return ok;
+}
+
+bool Assembler::assembleStream(std::istream& in, int outputFd) {
+    // One pass: every line is encoded as soon as it is read. An instruction
+    // whose operand is not yet placed is written with a zero address and
+    // remembered; once the address is known the instruction is written again
+    // in a text record of its own, which loaders apply over the first one.
+    // Lines in named USE blocks are held back until END, when the blocks'
+    // start addresses are known. Both wait in spill files rather than in
+    // memory, so memory is bounded by the symbol and block tables.
+    using clock = std::chrono::steady_clock;
+    stats = AssemblyStats();
+    size_t allocations = allocationCount(), allocated = allocatedBytes();
+    auto started = clock::now();
+
+    reset();
+    diags.begin("-", {});
+    if (!sizesAreLocal())
+        return error("Line sizes depend on the layout for this machine; streaming needs two passes");
+
+    ObjectWriter writer;
+    if (!writer.attach(outputFd))
+        return error("Could not write object program");
+
+    // Held lines are linked into one chain per block, so memory only holds
+    // the chain ends. Instructions waiting for a symbol are a plain log,
+    // read back in order at END, when every address is final.
+    SpillFile held, waiting;
+    struct HeldLine {
+        int64_t next;               // Next line of the same block, -1 at the end
+        int location;               // Block-relative location
+        int size;                   // Bytes of object code following the entry
+    };
+    struct Chain {
+        int64_t first = -1, last = -1;
+    };
+    static_assert(std::is_trivially_copyable_v<LineRecord>, "waiting records are spilled as bytes");
+    blocks.use("DEFAULT", 0);
+    std::vector<Chain> chains(1);   // Held lines of named blocks, by block number
+    int start_loc = 0, current_block_num = 0;
+    int text_end = 0;               // Address following the current text record
+    bool headerWritten = false;
+    std::vector<unsigned char> objectCode;
+    std::string problem;
+
+    // Add bytes at address to the text records, in the same way pass2 does
+    auto put = [&](int address, const unsigned char* bytes, size_t size) {
+        if (!writer.textEmpty() && address != text_end)
+            writer.flushText();
+        size_t written = 0;
+        while (written < size) {
+            size_t count = size - written;
+            if (writer.textLength() + count > ObjectWriter::MAX_TEXT_RECORD_LENGTH) {
+                writer.flushText();
+                count = std::min<size_t>(count, ObjectWriter::MAX_TEXT_RECORD_LENGTH);
+            }
+            if (writer.textEmpty())
+                writer.startText(address + static_cast<int>(written));
+            writer.addText(bytes + written, count);
+            written += count;
+        }
+        text_end = address + static_cast<int>(size);
+        stats.object_bytes += size;
+    };
+    // Encode an instruction again now that its operand is placed
+    auto patch = [&](LineRecord record, int operandAddress, int address) {
+        record.operand = symtab.name(record.symbol);
+        objectCode.clear();
+        if (std::get<0>(generateObjectCode(record, operandAddress, objectCode, problem)) < 0) {
+            lineError(record, problem);
+            return;
+        }
+        writer.flushText();
+        writer.startText(address);
+        writer.addText(objectCode.data(), objectCode.size());
+        writer.flushText();
+    };
+
+    // The source is not kept, so diagnostics only give a line number
     std::string line;
-    // Process intermediate file to generate text records
-    while (std::getline(intermediateFile, line)) {
-        std::istringstream iss(line);
-        std::string address, opcode, operand;
-        
-        // Skip lines without proper formatting
-        if (line.empty() || !isxdigit(line[0])) {
+    bool supported = true;
+    while (supported && std::getline(in, line)) {
+        stats.lines++;
+        int number = static_cast<int>(stats.lines);
+        SourceLine tokens = splitLine(line);
+        if (tokens.labelled) {
+            int id = symtab.intern(tokens.label);
+            defineLabel(id, tokens.label, blocks.location(current_block_num), current_block_num, number);
+            stats.symbol_lookups++;
+        }
+        if (tokens.operation.empty())
             continue;
+
+        LineRecord record = decodeLine(tokens, blocks.location(current_block_num), current_block_num);
+        record.line = number;
+        // Whatever needs more than one pass ends the assembly
+        if (isLinkageDirective(record.directive))
+            supported = diags.error("Control sections cannot be assembled in streaming mode", number);
+        else if (record.directive == Directive::MACRO)
+            supported = diags.error("Macros cannot be assembled in streaming mode", number);
+        else if (record.directive == Directive::LTORG || (record.directive == Directive::NONE && isLiteral(tokens.operand)))
+            supported = diags.error("Literals cannot be assembled in streaming mode", number);
+        if (!supported)
+            break;
+        if (!headerWritten && record.directive != Directive::START) {
+            writer.header(program_name, start_address, 0);
+            headerWritten = true;
         }
-        
-        iss >> address >> opcode >> operand;
-        
-        // Skip START and END directives for object code generation
-        if (opcode == "START" || opcode == "END" || opcode == "USE") {
+
+        if (record.directive == Directive::START) {
+            std::string_view operand = tokens.operand;
+            if (!operand.empty()) {
+                auto [end, status] = std::from_chars(operand.data(), operand.data() + operand.size(), start_loc, 16);
+                if (status != std::errc() || end == operand.data()) {
+                    diags.error("Invalid START address: " + std::string(operand), number);
+                    continue;
+                }
+                start_address = start_loc;
+                blocks.location(current_block_num) = start_loc;
+                if (!tokens.label.empty())
+                    program_name = tokens.label;
+            }
+            if (!headerWritten) {
+                writer.header(program_name, start_address, 0);
+                headerWritten = true;
+            }
             continue;
         }
-        
-        // Fetch opcode from optab
-        std::string opcodeValue = optab.value(opcode, "value");
-        std::string temp_operand = operand, actualOperand;
-        size_t commaPos = temp_operand.find(",X");
-        if (commaPos != std::string::npos) {
-              actualOperand = temp_operand.substr(0, commaPos); // Remove ,X from operand
+        if (record.directive == Directive::USE) {
+            std::string_view name = tokens.operand.empty() ? "DEFAULT" : tokens.operand;
+            current_block_num = blocks.use(name, start_loc);
+            stats.block_lookups++;
+            if (current_block_num == static_cast<int>(chains.size()))
+                chains.emplace_back();
+            continue;
         }
-        else
-              actualOperand = operand;
-        
-        // Fetch symbol from symtab if exists
-        std::string operandAddress = symtab.value(actualOperand, "value");
-        block_number = symtab.value(actualOperand, "block");
-        if(operandAddress != ""){
-            std::string block_start = block_table.value(block_number, "start_address");
-            
-            unsigned long addr1 = std::stoul(operandAddress, nullptr, 16);
-            unsigned long addr2 = std::stoul(block_start, nullptr, 16);
-            unsigned long addr3 = std::stoul(start_address, nullptr, 16);
+        if (record.directive == Directive::END)
+            break;
 
-            // Perform addition
-            unsigned long result = addr1 + (addr2 - addr3);
-
-            // Convert result back to hex string
-            std::stringstream ss;
-            ss << std::hex << std::uppercase << std::setfill('0') << std::setw(4) << result;
-            
-            operandAddress = ss.str();
+        int instruction_size = addressTranslation(tokens, record, problem);
+        if (instruction_size < 0) {
+            diags.error(problem, number);
+            continue;
         }
-        
-        // Generate object code for this instruction or directive
-        std::string objectCode;
-        int objectCodeLength = 0;
-        bool isReserveDirective = false;
-
-        try {
-            std::tie(objectCode, objectCodeLength, isReserveDirective) = generateObjectCode(opcode, operand, opcodeValue, operandAddress);
-        } catch (const std::exception& e) {
-            return error(e.what());
-        }
- 
-        // Handle reserve directives by ending current text record
-        if (isReserveDirective) {
-            if (!currentTextRecord.empty()) {
-                objectFile << "T " << textStartAddress << " " 
-                          << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
-                          << textRecordLength << " " << currentTextRecord << std::endl;
-                currentTextRecord = "";
-                textRecordLength = 0;
-                firstObjectCodeInRecord = true;
+        int operandAddress = SymbolTable::undefined;
+        if (record.symbol != SymbolTable::npos) {
+            if (symtab.defined(record.symbol) && symtab.block(record.symbol) == 0) {
+                operandAddress = symtab.address(record.symbol);
+            } else {
+                // Not placed yet: write a zero address and fix it at END
+                LineRecord pending = record;
+                pending.operand = std::string_view();
+                waiting.append(&pending, sizeof(pending));
+                operandAddress = 0;
             }
-            track_length += objectCodeLength;
+        }
+        objectCode.clear();
+        auto [length, isReserveDirective] = generateObjectCode(record, operandAddress, objectCode, problem);
+        if (length < 0) {
+            diags.error(problem, number);
             continue;
         }
-
-        // Check if new object code would exceed text record length
-        if (!objectCode.empty() && textRecordLength + objectCodeLength > MAX_TEXT_RECORD_LENGTH) {
-            // Write current text record
-            if (!currentTextRecord.empty()) {
-                objectFile << "T " << textStartAddress << " " 
-                          << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
-                          << textRecordLength << " " << currentTextRecord << std::endl;
-                currentTextRecord = "";
-                textRecordLength = 0;
-                firstObjectCodeInRecord = true;
+        if (current_block_num != 0) {
+            // Reserved space shows up as a gap between held lines; lines are
+            // linked in order, so the previous one is pointed at this one
+            Chain& block = chains[current_block_num];
+            if (!isReserveDirective && !objectCode.empty()) {
+                HeldLine entry{-1, record.location, static_cast<int>(objectCode.size())};
+                int64_t at = held.append(&entry, sizeof(entry));
+                held.append(objectCode.data(), objectCode.size());
+                if (block.last >= 0)
+                    held.write(block.last + offsetof(HeldLine, next), &at, sizeof(at));
+                else
+                    block.first = at;
+                block.last = at;
             }
+        } else if (isReserveDirective) {
+            writer.flushText();
+        } else {
+            put(record.location, objectCode.data(), objectCode.size());
         }
-        
-        // Start new text record if needed
-        if (!objectCode.empty() && currentTextRecord.empty()) {
-            std::stringstream ss;
-            ss << std::hex << std::uppercase << std::setfill('0') << std::setw(6) << track_length;
-            
-            textStartAddress = ss.str();
-            while (textStartAddress.length() < 6) {
-                textStartAddress = "0" + textStartAddress;
+        blocks.location(current_block_num) += instruction_size;
+        program_length += instruction_size;
+    }
+    if (!supported) {
+        writer.close();
+        reportDiagnostics();
+        return false;
+    }
+    if (!headerWritten)
+        writer.header(program_name, start_address, 0);
+
+    // Blocks follow each other in the order they were created
+    blocks.finish(start_loc);
+    std::vector<int> block_offset(blocks.size());
+    for (int i = 0; i < blocks.size(); i++)
+        block_offset[i] = blocks.startAddress(i) - start_loc;
+    for (int i = 1; i < blocks.size(); i++) {
+        for (int64_t at = chains[i].first; at >= 0;) {
+            HeldLine entry;
+            if (!held.read(at, &entry, sizeof(entry)))
+                break;
+            objectCode.resize(entry.size);
+            if (!held.read(at + sizeof(entry), objectCode.data(), objectCode.size()))
+                break;
+            put(entry.location + block_offset[i], objectCode.data(), objectCode.size());
+            at = entry.next;
+        }
+    }
+    for (int64_t at = 0; at < waiting.size(); at += sizeof(LineRecord)) {
+        LineRecord record;
+        if (!waiting.read(at, &record, sizeof(record)))
+            break;
+        int operandAddress = SymbolTable::undefined;
+        if (symtab.defined(record.symbol))
+            operandAddress = symtab.address(record.symbol) + block_offset[symtab.block(record.symbol)];
+        patch(record, operandAddress, record.location + block_offset[record.block]);
+    }
+
+    writer.end(start_address);
+    stats.text_records = writer.textRecords();
+    stats.blocks = blocks.size();
+    for (int id = 0; id < symtab.size(); id++)
+        stats.symbols += symtab.defined(id) ? 1 : 0;
+    // A pipe cannot be rewound; the header then keeps a zero length
+    writer.patchHeaderLength(program_length);
+    bool ok = writer.close() || error("Could not write object program");
+    if (held.failed() || waiting.failed())
+        ok = error("Could not use the spill files for held lines");
+    reportDiagnostics();
+    stats.total_seconds = std::chrono::duration<double>(clock::now() - started).count();
+    stats.allocations = allocationCount() - allocations;
+    stats.allocated_bytes = allocatedBytes() - allocated;
+    return ok && diags.errors() == 0;
+}
+
+AssemblyResult Assembler::assembleBuffer(std::string_view text) {
+    using clock = std::chrono::steady_clock;
+    AssemblyResult result;
+    stats = AssemblyStats();
+    size_t allocations = allocationCount(), allocated = allocatedBytes();
+    auto started = clock::now();
+
+    // Collect diagnostics instead of printing them
+    std::ostringstream diagnostics;
+    std::ostream* previousStream = errorStream();
+    setErrorStream(&diagnostics);
+
+    reset();
+    diags.begin({}, text);
+    ObjectWriter writer; // Never opened, so the records stay in memory
+    ObjectProgram image;
+    bool binaryOutput = opts.object_format != ObjectFormat::TEXT;
+    bool ok = pass1Buffer(text);
+    result.ok = generateObject(writer, ok && binaryOutput ? &image : nullptr) && ok;
+    setErrorStream(previousStream);
+
+    // Other messages first, then the source's errors and warnings in source order
+    std::string line;
+    for (std::istringstream lines(diagnostics.str()); std::getline(lines, line);)
+        result.diagnostics.push_back(line.starts_with("Error: ") ? line.substr(7) : line);
+    std::ostringstream sourceDiagnostics;
+    diags.write(sourceDiagnostics, DiagnosticFormat::TEXT);
+    for (std::istringstream lines(sourceDiagnostics.str()); std::getline(lines, line);)
+        result.diagnostics.push_back(line);
+    result.program_name = program_name;
+    result.start_address = start_address;
+    result.program_length = program_length;
+    if (result.ok) {
+        if (opts.object_format != ObjectFormat::BINARY)
+            result.object = writer.contents();
+        if (binaryOutput)
+            result.binary = formatBinaryObject(image);
+    }
+    for (int id = 0; id < symtab.size(); id++) {
+        if (symtab.defined(id))
+            result.symbols.push_back(AssemblyResult::Symbol{std::string(symtab.name(id)), symtab.address(id), symtab.block(id)});
+    }
+    for (int id = 0; id < blocks.size(); id++)
+        result.blocks.push_back(AssemblyResult::Block{std::string(blocks.name(id)), blocks.startAddress(id), blocks.length(id)});
+    if (opts.dumps == DumpFormat::TEXT) {
+        std::ostringstream symbolDump, blockDump;
+        symtab.write(symbolDump);
+        blocks.write(blockDump);
+        result.symbol_dump = symbolDump.str();
+        result.block_dump = blockDump.str();
+    } else if (opts.dumps == DumpFormat::SNAPSHOT) {
+        result.snapshot = formatSnapshot(symtab, blocks);
+    }
+    if (result.ok && opts.cross_reference)
+        result.cross_reference = xref.format(symtab);
+
+    stats.records = program.size();
+    stats.blocks = blocks.size();
+    stats.symbols = result.symbols.size();
+    stats.total_seconds = std::chrono::duration<double>(clock::now() - started).count();
+    stats.allocations = allocationCount() - allocations;
+    stats.allocated_bytes = allocatedBytes() - allocated;
+    result.stats = stats;
+    return result;
+}
+
+bool Assembler::assembleImage(std::string_view text, ObjectProgram& image, const std::string& name, ObjectWriter* writer) {
+    // One pass, straight into memory. A reference to a symbol or literal
+    // that is not placed yet is assembled with address 0 and joins that
+    // name's fixup chain; placing the name walks the chain and adds its
+    // address into every waiting address field, as a loader applies
+    // modification records. Only a bit per byte of memory marks where each
+    // line's object code starts, and there is no pass2.
+    using clock = std::chrono::steady_clock;
+    stats = AssemblyStats();
+    size_t allocations = allocationCount(), allocated = allocatedBytes();
+    auto started = clock::now();
+    reset();
+    diags.begin(name, text);
+    image = ObjectProgram();
+    if (!sizesAreLocal())
+        return error("Line sizes depend on the layout for this machine; load-and-go needs two passes");
+
+    constexpr int MEMORY_SIZE = 1 << 15;
+    struct Fixup {
+        int address;                // First byte of the waiting address field
+        int half_bytes;             // Field length in hex digits
+        int next;                   // Next fixup of the same chain, -1 at the end
+        int line;                   // Where the reference is, should it never be placed
+        std::string_view at;
+    };
+    std::vector<unsigned char> memory(MEMORY_SIZE);
+    std::vector<Fixup> fixups;
+    std::vector<int> symbolChains, literalChains;   // First fixup per id, -1 if none
+    std::vector<std::pair<int, int>> loaded;        // [start, end) ranges holding object code
+    std::vector<bool> lineStarts(MEMORY_SIZE);      // First byte of every line's object code
+    bool reserved = false;                          // A reservation ends the current range
+    std::vector<unsigned char> objectCode;
+    std::string problem;
+    int loc = 0, line = 0;
+
+    auto resolve = [&](std::vector<int>& chains, int id, int value) {
+        if (id >= static_cast<int>(chains.size()))
+            return;
+        for (int f = chains[id]; f >= 0; f = fixups[f].next) {
+            const Fixup& fixup = fixups[f];
+            int size = (fixup.half_bytes + 1) / 2;
+            uint32_t field = 0;
+            for (int i = 0; i < size; i++)
+                field = field << 8 | memory[fixup.address + i];
+            uint32_t mask = (uint32_t(1) << (4 * fixup.half_bytes)) - 1;
+            field = (field & ~mask) | ((field + value) & mask);
+            for (int i = size; i-- > 0; field >>= 8)
+                memory[fixup.address + i] = static_cast<unsigned char>(field);
+        }
+        chains[id] = -1;
+    };
+    auto wait = [&](std::vector<int>& chains, int id, const LineRecord& record) {
+        if (id >= static_cast<int>(chains.size()))
+            chains.resize(id + 1, -1);
+        auto [offset, halfBytes] = addressField(record);
+        fixups.push_back(Fixup{record.location + offset, halfBytes, chains[id], line, record.operand});
+        chains[id] = static_cast<int>(fixups.size()) - 1;
+    };
+    // Size a line, reporting a bad one, before its operand waits for anything
+    auto translate = [&](const SourceLine& tokens, const LineRecord& record) {
+        int size = addressTranslation(tokens, record, problem);
+        if (size < 0)
+            diags.error(problem, line, tokens.operation);
+        return size;
+    };
+    // Assemble a line of the given size at loc; false once the program
+    // outgrows memory
+    auto place = [&](const SourceLine& tokens, const LineRecord& record, int operandAddress, int size) {
+        if (loc + size > MEMORY_SIZE)
+            return diags.error("Program does not fit in memory", line, tokens.operation);
+        objectCode.clear();
+        auto [length, reserve] = generateObjectCode(record, operandAddress, objectCode, problem);
+        if (length < 0)
+            diags.error(problem, line, tokens.operand);
+        else if (reserve)
+            reserved = true;
+        else if (!objectCode.empty()) {
+            std::copy(objectCode.begin(), objectCode.end(), memory.begin() + loc);
+            int end = loc + static_cast<int>(objectCode.size());
+            if (!loaded.empty() && loaded.back().second == loc && !reserved)
+                loaded.back().second = end;
+            else
+                loaded.emplace_back(loc, end);
+            lineStarts[loc] = true;
+            reserved = false;
+            stats.object_bytes += objectCode.size();
+        }
+        stats.records++;
+        loc += size;
+        return true;
+    };
+    auto placeLiterals = [&]() {
+        for (int id : literals.pending()) {
+            Directive kind = literals.isWord(id) ? Directive::WORD : Directive::BYTE;
+            SourceLine constant{false, {}, directiveName(kind), literals.text(id)};
+            LineRecord record{loc, 0, -1, kind, literals.text(id), SymbolTable::npos, false};
+            int size = translate(constant, record);
+            literals.place(id, loc, 0);
+            resolve(literalChains, id, loc);
+            if (size >= 0 && !place(constant, record, SymbolTable::undefined, size))
+                return false;
+        }
+        literals.closePool();
+        return true;
+    };
+
+    // Bad lines are reported and left out; USE blocks, control sections
+    // and running out of memory stop the assembly
+    MacroReader reader(text, macros, diags);
+    SourceLine tokens;
+    bool ok = true, ended = false;
+    while (ok && reader.next(tokens)) {
+        line = static_cast<int>(reader.linesRead());
+        if (tokens.labelled) {
+            int id = symtab.intern(tokens.label);
+            defineLabel(id, tokens.label, loc, 0, line);
+            stats.symbol_lookups++;
+            resolve(symbolChains, id, loc);
+        }
+        if (tokens.operation.empty())
+            continue;
+
+        LineRecord record = decodeLine(tokens, loc, 0);
+        record.line = line;
+        std::string_view operand = tokens.operand;
+        if (record.directive == Directive::START) {
+            int address = loc;
+            auto [end, status] = std::from_chars(operand.data(), operand.data() + operand.size(), address, 16);
+            if (!operand.empty() && (status != std::errc() || end == operand.data())) {
+                lineError(record, "Invalid START address: " + std::string(operand));
+                continue;
+            }
+            start_address = loc = address;
+            if (!operand.empty() && !tokens.label.empty()) {
+                program_name = tokens.label;
+                symtab.define(symtab.intern(tokens.label), loc, 0);
             }
-            std::transform(textStartAddress.begin(), textStartAddress.end(), textStartAddress.begin(), ::toupper);
+            continue;
         }
-        
-        // Add the object code to the current text record
-        if (!objectCode.empty()) {
-            // Add space before object code if not the first in record
-            if (!firstObjectCodeInRecord) {
-                currentTextRecord += " ";
+        if (record.directive == Directive::END) {
+            ok = placeLiterals();
+            ended = true;
+            break;
+        }
+        if (record.directive == Directive::LTORG) {
+            ok = placeLiterals();
+            continue;
+        }
+        if (record.directive == Directive::USE) {
+            if (!operand.empty() && operand != "DEFAULT")
+                ok = lineError(record, "USE blocks cannot be assembled in load-and-go mode");
+            continue;
+        }
+        if (isLinkageDirective(record.directive)) {
+            ok = diags.error("Control sections cannot be assembled in load-and-go mode", line, tokens.operation);
+            continue;
+        }
+
+        int size = translate(tokens, record);
+        if (size < 0)
+            continue;
+        int operandAddress = SymbolTable::undefined;
+        if (record.directive == Directive::NONE && isLiteral(operand)) {
+            std::string_view literal = operand.substr(1, operand.find(",X") - 1);
+            if (!literals.add(literal, record.literal)) {
+                lineError(record, "Invalid literal: " + std::string(operand));
+                continue;
             }
-            
-            currentTextRecord += objectCode;
-            textRecordLength += objectCodeLength;
-            firstObjectCodeInRecord = false;
+            operandAddress = 0;
+            wait(literalChains, record.literal, record);
+        } else if (record.symbol != SymbolTable::npos && symtab.defined(record.symbol)) {
+            operandAddress = symtab.address(record.symbol);
+        } else if (record.symbol != SymbolTable::npos) {
+            operandAddress = 0;
+            wait(symbolChains, record.symbol, record);
         }
-        track_length += objectCodeLength;
+        ok = place(tokens, record, operandAddress, size);
     }
-    
-    // Write final text record if not empty
-    if (!currentTextRecord.empty()) {
-        objectFile << "T " << textStartAddress << " " 
-                  << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
-                  << textRecordLength << " " << currentTextRecord << std::endl;
+    stats.lines = reader.linesRead();
+    if (ok && !ended && !reader.failed())
+        diags.warning("Missing END directive");
+
+    // Whatever still waits was never defined; the chain ends at its first use
+    for (int id = 0; ok && id < static_cast<int>(symbolChains.size()); id++) {
+        int first = symbolChains[id];
+        if (first < 0)
+            continue;
+        while (fixups[first].next >= 0)
+            first = fixups[first].next;
+        diags.error("Undefined symbol: " + std::string(symtab.name(id)), fixups[first].line, fixups[first].at);
+    }
+    if (diags.errors() > 0) {
+        reportDiagnostics();
+        return false;
     }
-    
-    // Write end record with start address
-    objectFile << "E " << paddedStartAddress << std::endl;
-    
-    intermediateFile.close();
-    objectFile.close();
-    return true;
-}
 
-void Assembler::assemble(const std::string& filename) {
-    pass1(filename);
-    size_t dotPos = filename.find('.'); // Find first occurrence of '.'
-    std::string baseName = (dotPos == std::string::npos) ? filename : filename.substr(0, dotPos);
-    symtab.dump(baseName + ".symbol.dump");
-    block_table.dump(baseName + ".block.dump");
-    pass2(filename);
+    program_length = loc - start_address;
+    image.name = program_name;
+    image.start_address = start_address;
+    image.program_length = program_length;
+    image.entry_address = start_address;
+    for (const auto& [begin, end] : loaded)
+        image.addBytes(begin, memory.data() + begin, end - begin);
+
+    // Text records as pass2 writes them: one object code per line, a line
+    // moves to the next record rather than being split unless it is longer
+    // than a record, and a reservation ends the record
+    if (writer) {
+        writer->header(program_name, start_address, program_length);
+        for (const auto& [begin, end] : loaded) {
+            writer->flushText();
+            for (int address = begin, next; address < end; address = next) {
+                for (next = address + 1; next < end && !lineStarts[next]; next++) {}
+                size_t size = next - address, written = 0;
+                while (written < size) {
+                    size_t count = size - written;
+                    if (writer->textLength() + count > ObjectWriter::MAX_TEXT_RECORD_LENGTH) {
+                        writer->flushText();
+                        count = std::min<size_t>(count, ObjectWriter::MAX_TEXT_RECORD_LENGTH);
+                    }
+                    if (writer->textEmpty())
+                        writer->startText(address + static_cast<int>(written));
+                    writer->addText(memory.data() + address + written, count);
+                    written += count;
+                }
+            }
+        }
+        writer->end(start_address);
+        stats.text_records = writer->textRecords();
+    }
+    for (int id = 0; id < symtab.size(); id++)
+        stats.symbols += symtab.defined(id) ? 1 : 0;
+    reportDiagnostics();
+    stats.pass1_seconds = stats.total_seconds = std::chrono::duration<double>(clock::now() - started).count();
+    stats.allocations = allocationCount() - allocations;
+    stats.allocated_bytes = allocatedBytes() - allocated;
+    return true;
 }
 
+bool Assembler::loadAndGo(const std::string& filename) {
+    if (!source.open(filename))
+        return error("Could not open file " + filename);
+    ObjectProgram image;
+    ObjectWriter writer; // Kept in memory until the program assembled
+    std::string baseName = outputBase(filename);
+    if (!assembleImage(source.text(), image, filename, opts.object_format != ObjectFormat::BINARY ? &writer : nullptr)) {
+        // An object file left from an earlier run must not pass for this one
+        std::error_code ignored;
+        std::filesystem::remove(baseName + ".obj", ignored);
+        std::filesystem::remove(baseName + ".sicb", ignored);
+        return false;
+    }
 
+    // Only the object program is written; there are no dumps
+    if (opts.object_format != ObjectFormat::TEXT && !writeBinaryObject(baseName + ".sicb", image))
+        return false;
+    if (opts.object_format != ObjectFormat::BINARY) {
+        std::ofstream objectFile(baseName + ".obj");
+        if (!objectFile.is_open())
+            return error("Could not create object file " + baseName + ".obj");
+        objectFile << writer.contents();
+    }
+    return true;
+}
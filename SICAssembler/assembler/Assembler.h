@@ -1,32 +1,190 @@
 #ifndef ASSEMBLER_H
 #define ASSEMBLER_H
 
+#include <cstdint>
+#include <functional>
+#include <istream>
 #include <string>
-#include <map>
-#include "table.h"
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "block.h"
+#include "symtab.h"
+#include "optab.h"
+#include "source.h"
+#include "stats.h"
+#include "cache.h"
+#include "diagnostics.h"
+#include "literal.h"
+#include "macro.h"
+#include "xref.h"
+
+// Directive kinds recognised by pass1; NONE marks a machine instruction
+enum class Directive : unsigned char { NONE, START, END, USE, BYTE, WORD, RESB, RESW, CSECT, EXTDEF, EXTREF, MACRO, MEND, LTORG,
+                                      BASE, NOBASE };
+
+// Decoded source line produced by pass1 and consumed directly by pass2
+struct LineRecord {
+    int location;           // Block-relative location counter value
+    int block;              // USE block number
+    int opcode;             // Opcode byte from optab, -1 for directives
+    Directive directive;    // Directive kind, NONE for instructions
+    std::string_view operand; // First operand token, a view into the source text
+    int symbol;             // Symbol id of an instruction operand, SymbolTable::npos if none
+    bool indexed;           // Operand uses indexed addressing (,X)
+    unsigned char format = 3; // Instruction format from optab, 4 for +operation (SIC/XE)
+    char prefix = 0;        // Operand prefix: '#' immediate, '@' indirect, 0 for simple addressing
+    int literal = -1;       // Literal table id of an =constant operand, -1 if none
+    int line = 0;           // Source line, for diagnostics of lines without a view into the source
+    int base = -1;          // Base register value for base-relative displacements, -1 after NOBASE
+};
+
+enum class ObjectFormat { TEXT, BINARY, BOTH };
+enum class Machine { SIC, SICXE };
+enum class DumpFormat { TEXT, SNAPSHOT, NONE };
+
+// A control section: located from 0, with its own symbols, and linked with
+// the others through the names it exports (EXTDEF) and imports (EXTREF)
+struct ControlSection {
+    std::string name;
+    int start_address = 0;
+    int length = 0;
+    std::vector<std::string_view> definitions;  // Views into the source text
+    std::vector<std::string_view> references;
+};
+
+struct AssemblerOptions {
+    bool intermediate = false; // Also write <base>.intermediate for debugging
+    ObjectFormat object_format = ObjectFormat::TEXT; // .obj records, .sicb binary or both
+    unsigned threads = 1;      // Worker threads for large programs
+    std::string cache_dir;     // Reuse results from this cache directory, empty to disable
+    DiagnosticFormat diagnostic_format = DiagnosticFormat::TEXT; // How errors and warnings are printed
+    Machine machine = Machine::SIC; // Which Assembler subclass makeAssembler() creates
+    DumpFormat dumps = DumpFormat::TEXT; // .symbol.dump and .block.dump, a .snapshot, or nothing
+    bool cross_reference = false; // Also write <base>.xref, where every symbol is defined and used
+};
+
+// Everything assembleBuffer() produces, for callers that embed the assembler
+struct AssemblyResult {
+    struct Symbol {
+        std::string name;
+        int address;                // Relative to the start of its block
+        int block;
+    };
+    struct Block {
+        std::string name;
+        int start_address;
+        int length;
+    };
+
+    bool ok = false;
+    std::string program_name;
+    int start_address = 0;
+    int program_length = 0;
+    std::string object;             // H/T/E records, unless the format is BINARY
+    std::string binary;             // .sicb image, unless the format is TEXT
+    std::vector<Symbol> symbols;
+    std::vector<Block> blocks;      // Indexed by block number
+    std::string symbol_dump;        // Text of the .symbol.dump file, if the dumps are TEXT
+    std::string block_dump;         // Text of the .block.dump file, if the dumps are TEXT
+    std::string snapshot;           // .snapshot image, if the dumps are SNAPSHOT
+    std::string cross_reference;    // .xref image, if asked for and the program is clean
+    std::vector<std::string> diagnostics; // Errors and warnings as text lines, without a file name
+    AssemblyStats stats;
+};
+
+class ObjectWriter;
+struct ObjectProgram;
 
 class Assembler {
 public:
-    Assembler(const std::string& opcode_file) {
-        optab.init(opcode_file);
-    }
+    static constexpr size_t PARALLEL_PASS1_MIN_BYTES = 1 << 18; // Smaller sources are sized serially
+    static constexpr size_t PARALLEL_PASS2_MIN_LINES = 1 << 14; // Smaller programs are encoded serially
+
+    Assembler(const Optab& optab = Optab::builtin())
+        : optab(optab) {}
     virtual ~Assembler() = default; // Virtual destructor for proper cleanup
-    void assemble(const std::string& filename);
+    bool assemble(const std::string& filename);
+    // Assemble text read from in in a single pass, writing the object
+    // program to outputFd as it goes; no other files are written
+    bool assembleStream(std::istream& in, int outputFd);
+    // Assemble a source held in memory. Nothing is read from or written to
+    // disk, so one Optab can serve any number of calls.
+    AssemblyResult assembleBuffer(std::string_view text);
+    // Load-and-go: assemble text in one pass straight into a memory image,
+    // with no dumps and no second pass. Forward references are patched
+    // through per-symbol fixup chains. USE blocks and control sections are
+    // not supported. name is the file diagnostics are reported against;
+    // with a writer, the text records pass2 would write also go to it.
+    bool assembleImage(std::string_view text, ObjectProgram& image, const std::string& name = "",
+                       ObjectWriter* writer = nullptr);
+    bool loadAndGo(const std::string& filename);   // assembleImage() on a file, writing only the object
+    AssemblerOptions& options() { return opts; }
+    size_t linesRead() const { return stats.lines; }
+    size_t objectBytes() const { return stats.object_bytes; }
+    const AssemblyStats& statistics() const { return stats; }
+    const Diagnostics& diagnostics() const { return diags; }
 
 protected:
     // Data Structures (can be used by derived classes)
-    Table symtab;
-    Table optab;
-    Table block_table;
-    std::map<int, int> loc_counter;
-    std::string program_length;
-    std::string start_address;
+    SymbolTable symtab;
+    const Optab& optab;
+    BlockTable blocks;                      // USE blocks and their location counters
+    SourceFile source;
+    std::vector<LineRecord> program;
+    int program_length = 0;
+    int start_address = 0;
     std::string program_name;
+    std::vector<ControlSection> sections;   // The program itself is the first one
+    bool linkable = false;                  // CSECT, EXTDEF or EXTREF was used
+    MacroTable macros;                      // Definitions and expansions, alive until pass2 is done
+    LiteralTable literals;                  // =constant operands and where their pools were placed
+    CrossReference xref;                    // Definition and use sites, if opts.cross_reference
+    AssemblerOptions opts;
+    AssemblyStats stats;        // Counters and timings of the last assembly
+    Diagnostics diags;          // Errors and warnings of the last assembly
     
-    virtual int addressTranslation(const std::string& opcode, const std::string& line) = 0;
-    virtual std::tuple<std::string, int, bool> generateObjectCode(const std::string& opcode, const std::string& operand, std::string opcodeValue, std::string operandAddress) = 0;
+    // Size in bytes of the line. It may only depend on the line itself, as
+    // pass1 calls it concurrently for different parts of large sources.
+    // A malformed line gives -1 and the reason in problem; nothing throws.
+    virtual int addressTranslation(const SourceLine& line, const LineRecord& record, std::string& problem) = 0;
+    // Appends the object code bytes of record to objectCode and returns
+    // their length plus whether the line reserves storage (RESB/RESW), or
+    // a length of -1 and the reason in problem. record.location is the
+    // line's address in the program, whatever its block.
+    // Called concurrently for different lines when pass2 runs in parallel.
+    virtual std::tuple<int, bool> generateObjectCode(const LineRecord& record, int operandAddress, std::vector<unsigned char>& objectCode,
+                                                     std::string& problem) = 0;
+    // Whether an operation's operand can change the size of its line
+    virtual bool operandAffectsLayout(std::string_view operation) const;
+    // Whether every line's size follows from the line alone. If not, the
+    // one-pass modes are refused, pass1 layouts are not cached, and relax()
+    // settles the sizes once pass1 has placed every line.
+    virtual bool sizesAreLocal() const { return true; }
+    virtual void relax() {}
+    // Where an instruction's operand address sits in its object code, for
+    // modification records: byte offset and length in hex digits, or a
+    // length of 0 if the operand is relative and needs no modification
+    virtual std::pair<int, int> addressField(const LineRecord& record) const;
+    LineRecord decodeLine(const SourceLine& tokens, int location, int block, int section = 0);
+    uint64_t layoutKey(std::string_view text) const;
+    void saveLayout(CachedLayout& layout) const;
+    bool pass1Replay(std::string_view text, const CachedLayout& layout);
     bool pass1(const std::string& filename);
+    bool pass1Buffer(std::string_view text);    // text must outlive pass2
+    bool pass1Parallel(std::string_view text, bool& ok);  // false if the source needs the serial pass
+    void reset();                               // Empty every table before a new program
     bool pass2(const std::string& filename);
+    bool generateObject(ObjectWriter& writer, ObjectProgram* image);
+    std::tuple<int, bool> encodeLine(const LineRecord& record, const std::vector<int>& block_offset,
+                                     std::vector<unsigned char>& objectCode, size_t& lookups, std::string& problem);
+    void defineLabel(int id, std::string_view label, int address, int block, int line);
+    bool lineError(const LineRecord& record, std::string message);   // Always false
+    void reportDiagnostics();                   // Print diags in the chosen format
+    bool pass2Parallel(const std::vector<int>& block_offset,
+                       const std::function<void(const LineRecord&, const unsigned char*, size_t, bool)>& emit);
+    bool writeIntermediate(const std::string& filename) const;
 };
 
 #endif // ASSEMBLER_H
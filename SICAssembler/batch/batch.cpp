@@ -0,0 +1,100 @@
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include "batch.h"
+#include "error.h"
+#include "pool.h"
+#include "SICXEasm.h"
+
+namespace {
+
+struct BatchResult {
+    bool done = false;
+    bool ok = false;
+    size_t lines = 0;
+    size_t bytes = 0;
+    std::string diagnostics;
+    std::string statistics;
+};
+
+} // namespace
+
+bool readManifest(const std::string& filename, std::vector<std::string>& files) {
+    std::ifstream manifest(filename);
+    if (!manifest.is_open())
+        return error("Could not open manifest " + filename);
+    std::string line;
+    while (std::getline(manifest, line)) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+        size_t last = line.find_last_not_of(" \t\r");
+        files.push_back(line.substr(first, last - first + 1));
+    }
+    return true;
+}
+
+bool assembleBatch(const std::vector<std::string>& files, const Optab& optab,
+                   const AssemblerOptions& options, unsigned jobs, StatsFormat statsFormat) {
+    std::vector<BatchResult> results(files.size());
+    std::mutex results_lock;
+    std::condition_variable result_ready;
+
+    auto started = std::chrono::steady_clock::now();
+    ThreadPool pool(jobs);
+    for (size_t i = 0; i < files.size(); i++) {
+        pool.submit([&, i] {
+            std::ostringstream diagnostics;
+            setErrorStream(&diagnostics);
+            std::unique_ptr<Assembler> sic = makeAssembler(optab, options);
+            bool ok = false;
+            try {
+                ok = sic->assemble(files[i]);
+            } catch (const std::exception& e) {
+                // One bad file must not take the rest of the batch down
+                error(e.what());
+            }
+            setErrorStream(nullptr);
+            std::ostringstream statistics;
+            printStats(statistics, files[i], sic->statistics(), statsFormat);
+
+            std::lock_guard<std::mutex> guard(results_lock);
+            BatchResult& result = results[i];
+            result.ok = ok;
+            result.lines = sic->linesRead();
+            result.bytes = sic->objectBytes();
+            result.diagnostics = diagnostics.str();
+            result.statistics = statistics.str();
+            result.done = true;
+            result_ready.notify_one();
+        });
+    }
+
+    // Print diagnostics in input order as soon as each prefix of files is done
+    size_t failed = 0, lines = 0, bytes = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        std::unique_lock<std::mutex> guard(results_lock);
+        result_ready.wait(guard, [&] { return results[i].done; });
+        const BatchResult& result = results[i];
+        if (!result.diagnostics.empty())
+            std::cerr << result.diagnostics;    // Source diagnostics name their file
+        std::cerr << result.statistics;
+        failed += result.ok ? 0 : 1;
+        lines += result.lines;
+        bytes += result.bytes;
+    }
+    pool.wait();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    std::cerr << std::fixed << std::setprecision(3)
+              << "Assembled " << files.size() - failed << "/" << files.size() << " files with "
+              << pool.size() << " threads in " << seconds << " s: "
+              << lines << " lines (" << std::setprecision(0) << (seconds > 0 ? lines / seconds : 0) << " lines/s), "
+              << bytes << " object bytes (" << (seconds > 0 ? bytes / seconds : 0) << " bytes/s), "
+              << std::setprecision(1) << (seconds > 0 ? files.size() / seconds : 0) << " files/s" << std::endl;
+    return failed == 0;
+}
@@ -0,0 +1,19 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+#include "Assembler.h"
+
+// Read one source path per line; blank lines and lines starting with '#' are skipped
+bool readManifest(const std::string& filename, std::vector<std::string>& files);
+
+// Assemble every file on a shared thread pool, one assembler per file, all
+// sharing one read-only optab. Diagnostics are printed per file in input
+// order (with their statistics if requested), followed by a throughput
+// summary. Returns true if every file assembled.
+bool assembleBatch(const std::vector<std::string>& files, const Optab& optab,
+                   const AssemblerOptions& options, unsigned jobs,
+                   StatsFormat statsFormat = StatsFormat::NONE);
+
+#endif // BATCH_H
@@ -0,0 +1,104 @@
+// Benchmark harness: assembles each source several times and reports the
+// best time of every phase, as lines/s and bytes/s.
+//
+//   pass1  source lines and source bytes
+//   dumps  symbol and block table rows and dump bytes written
+//   pass2  decoded lines and object code bytes
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "SICasm.h"
+
+namespace {
+
+struct PhaseTimes {
+    double pass1 = 1e30, dumps = 1e30, pass2 = 1e30;
+    size_t source_bytes = 0, source_lines = 0;
+    size_t dump_bytes = 0, dump_rows = 0;
+    size_t records = 0, object_bytes = 0;
+};
+
+// Runs the phases of Assembler::assemble one at a time so each can be timed
+class BenchAssembler : public SIC_assembler {
+public:
+    bool run(const std::string& filename, const std::string& dumpBase, PhaseTimes& times) {
+        using clock = std::chrono::steady_clock;
+        auto seconds = [](clock::time_point from) {
+            return std::chrono::duration<double>(clock::now() - from).count();
+        };
+
+        auto started = clock::now();
+        if (!pass1(filename))
+            return false;
+        times.pass1 = std::min(times.pass1, seconds(started));
+
+        started = clock::now();
+        symtab.dump(dumpBase + ".symbol.dump");
+        blocks.dump(dumpBase + ".block.dump");
+        times.dumps = std::min(times.dumps, seconds(started));
+
+        started = clock::now();
+        if (!pass2(filename))
+            return false;
+        times.pass2 = std::min(times.pass2, seconds(started));
+
+        times.source_lines = linesRead();
+        times.source_bytes = std::filesystem::file_size(filename);
+        times.dump_rows = symtab.size();
+        times.dump_bytes = std::filesystem::file_size(dumpBase + ".symbol.dump") +
+                           std::filesystem::file_size(dumpBase + ".block.dump");
+        times.records = program.size();
+        times.object_bytes = objectBytes();
+        return true;
+    }
+};
+
+void report(const std::string& name, double seconds, size_t lines, size_t bytes) {
+    std::cout << "  " << std::left << std::setw(6) << name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(10) << seconds * 1000 << " ms"
+              << std::setprecision(0) << std::setw(14) << lines / seconds << " lines/s"
+              << std::setprecision(2) << std::setw(10) << bytes / seconds / 1e6 << " MB/s\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int iterations = 5;
+    std::vector<std::string> files;
+    bool usage = false;
+    for (int i = 1; i < argc && !usage; i++) {
+        std::string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc) {
+            std::string_view count = argv[++i];
+            auto [end, status] = std::from_chars(count.data(), count.data() + count.size(), iterations);
+            usage = status != std::errc() || end != count.data() + count.size() || iterations < 1;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (usage || files.empty()) {
+        std::cerr << "Usage: sic_bench [--iterations n] file.asm...\n";
+        return 1;
+    }
+
+    for (const std::string& file : files) {
+        PhaseTimes times;
+        std::string dumpBase = (std::filesystem::temp_directory_path() / "sic_bench").string();
+        for (int i = 0; i < iterations; i++) {
+            BenchAssembler assembler;
+            if (!assembler.run(file, dumpBase, times))
+                return 1;
+        }
+        std::cout << file << ": " << times.source_lines << " lines, " << times.source_bytes << " bytes, best of "
+                  << iterations << "\n";
+        report("pass1", times.pass1, times.source_lines, times.source_bytes);
+        report("dumps", times.dumps, times.dump_rows, times.dump_bytes);
+        report("pass2", times.pass2, times.records, times.object_bytes);
+    }
+    return 0;
+}
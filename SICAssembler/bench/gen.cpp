@@ -0,0 +1,179 @@
+// Synthetic SIC program generator for benchmarks.
+//
+// Emits a valid SIC program whose size and shape are set on the command
+// line. Programs larger than 32K bytes no longer fit SIC memory and are
+// meant for throughput runs only; their operands only name labels below
+// 8000 (hex), which is all a SIC address field can hold.
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Shape {
+    long lines = 10000;         // Statements after START
+    double directives = 0.2;    // Fraction of WORD/BYTE/RESW/RESB statements
+    int label_every = 4;        // Every n-th statement gets a label
+    int blocks = 0;             // Number of USE blocks besides the default one
+    int block_run = 50;         // Statements emitted before switching blocks
+    double forward = 0.3;       // Fraction of operands that are forward references
+    int byte_length = 8;        // Characters in BYTE C'...' constants
+    double indexed = 0.1;       // Fraction of instruction operands using ,X
+    unsigned seed = 1;
+};
+
+// One generated line, decided before any operand is picked
+struct Statement {
+    long block;                 // USE block, 0 for the default one
+    bool use;                   // Preceded by a USE switching to block
+    bool labelled;
+    int kind;                   // Directive case, -1 for an instruction
+    long value;                 // Directive operand, or the mnemonic index
+    bool indexed;
+};
+
+struct Label {
+    long block;
+    long offset;                // Within its block
+};
+
+const char* const mnemonics[] = {
+    "LDA", "AND", "DIV", "SUB", "ADD", "LDL", "RD", "WD", "LDCH", "STX", "JLT", "TIX",
+    "TD", "STCH", "STL", "LDX", "STA", "J", "JEQ", "COMP", "JSUB", "JGT", "MUL", "OR", "STSW",
+};
+
+// Parse all of text as a number; false on anything else
+template <typename T>
+bool parseNumber(std::string_view text, T& value) {
+    auto [end, status] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return status == std::errc() && end != text.data() && end == text.data() + text.size();
+}
+
+bool parseArgs(int argc, char** argv, Shape& shape) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string_view value = argv[i + 1];
+        bool valid;
+        if (arg == "--lines") valid = parseNumber(value, shape.lines);
+        else if (arg == "--directives") valid = parseNumber(value, shape.directives);
+        else if (arg == "--label-every") valid = parseNumber(value, shape.label_every) && shape.label_every >= 1;
+        else if (arg == "--blocks") valid = parseNumber(value, shape.blocks);
+        else if (arg == "--block-run") valid = parseNumber(value, shape.block_run) && shape.block_run >= 1;
+        else if (arg == "--forward") valid = parseNumber(value, shape.forward);
+        else if (arg == "--byte-length") valid = parseNumber(value, shape.byte_length) && shape.byte_length >= 1;
+        else if (arg == "--indexed") valid = parseNumber(value, shape.indexed);
+        else if (arg == "--seed") valid = parseNumber(value, shape.seed);
+        else return false;
+        if (!valid)
+            return false;
+    }
+    return argc % 2 == 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Shape shape;
+    if (!parseArgs(argc, argv, shape)) {
+        std::cerr << "Usage: sic_gen [--lines n] [--directives f] [--label-every n] [--blocks n]\n"
+                     "               [--block-run n] [--forward f] [--byte-length n] [--indexed f] [--seed n]\n";
+        return 1;
+    }
+
+    std::mt19937 rng(shape.seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    const std::string constant(shape.byte_length, 'A');
+
+    // Lay the program out first: a SIC operand must lie below 8000 (hex), so
+    // operands can only name labels that the assembler places there
+    std::vector<Statement> statements;
+    statements.reserve(shape.lines + 1);
+    std::vector<long> blockSize(shape.blocks + 1, 0);
+    std::vector<Label> labels;
+    long block = 0;
+    for (long line = 0; line < shape.lines; line++) {
+        // Switch USE blocks in runs so every block gets a share of the code
+        bool use = shape.blocks > 0 && line % shape.block_run == 0;
+        if (use)
+            block = (line / shape.block_run) % (shape.blocks + 1);
+        Statement statement{block, use, line % shape.label_every == 0, -1, 0, false};
+        long size = 3;
+        if (chance(rng) < shape.directives) {
+            statement.kind = static_cast<int>(rng() % 5);
+            switch (statement.kind) {
+                case 0: statement.value = rng() % 10000; break;
+                case 1: size = shape.byte_length; break;
+                case 2: size = 2; break;
+                case 3: statement.value = 1 + rng() % 4; size = 3 * statement.value; break;
+                default: statement.value = 1 + rng() % 16; size = statement.value; break;
+            }
+        } else {
+            statement.value = rng() % (sizeof(mnemonics) / sizeof(mnemonics[0]));
+            statement.indexed = chance(rng) < shape.indexed;
+        }
+        if (statement.labelled)
+            labels.push_back(Label{block, blockSize[block]});
+        blockSize[block] += size;
+        statements.push_back(statement);
+    }
+    blockSize[block] += 3;      // The closing RSUB
+
+    // Blocks follow each other in the order they were first used, which is
+    // their number; keep the labels that end up addressable
+    std::vector<long> blockStart(shape.blocks + 1, 0);
+    for (size_t i = 1; i < blockStart.size(); i++)
+        blockStart[i] = blockStart[i - 1] + blockSize[i - 1];
+    std::vector<long> reachable;
+    for (size_t i = 0; i < labels.size(); i++) {
+        if (blockStart[labels[i].block] + labels[i].offset < 0x8000)
+            reachable.push_back(static_cast<long>(i));
+    }
+
+    std::string out;
+    out.reserve(1 << 20);
+    out += "GEN:\tSTART\t0\n";
+    long next_label = 0;
+    for (const Statement& statement : statements) {
+        if (statement.use)
+            out += statement.block == 0 ? "\tUSE\n" : "\tUSE\tB" + std::to_string(statement.block) + "\n";
+        if (statement.labelled)
+            out += "L" + std::to_string(next_label++) + ":";
+        out += '\t';
+
+        switch (statement.kind) {
+            case 0: out += "WORD\t" + std::to_string(statement.value); break;
+            case 1: out += "BYTE\tC'" + constant + "'"; break;
+            case 2: out += "BYTE\tX'F1E2'"; break;
+            case 3: out += "RESW\t" + std::to_string(statement.value); break;
+            case 4: out += "RESB\t" + std::to_string(statement.value); break;
+            default: {
+                out += mnemonics[statement.value];
+                out += '\t';
+                // Backward references pick a defined label, forward ones a
+                // later label, among those that are addressable
+                auto later = std::lower_bound(reachable.begin(), reachable.end(), next_label);
+                long before = later - reachable.begin(), after = reachable.end() - later;
+                long target;
+                if (before == 0 || (after > 0 && chance(rng) < shape.forward))
+                    target = later[rng() % after];
+                else
+                    target = reachable[rng() % before];
+                out += "L" + std::to_string(target);
+                if (statement.indexed)
+                    out += ",X";
+            }
+        }
+        out += '\n';
+
+        if (out.size() >= (1 << 20)) {
+            std::cout << out;
+            out.clear();
+        }
+    }
+    out += "\tRSUB\n\tEND\tGEN\n";
+    std::cout << out;
+    return 0;
+}
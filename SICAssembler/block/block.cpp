@@ -0,0 +1,77 @@
+#include <fstream>
+#include <iomanip>
+#include "block.h"
+#include "error.h"
+
+void BlockTable::clear() {
+    names.clear();
+    locations.clear();
+    start_addresses.clear();
+    lengths.clear();
+    ids.clear();
+    finished = false;
+}
+
+int BlockTable::use(std::string_view name, int start) {
+    auto found = ids.find(name);
+    if (found != ids.end())
+        return found->second;
+    int id = size();
+    names.emplace_back(name);
+    locations.push_back(start);
+    start_addresses.push_back(0);   // Known once the program ends
+    lengths.push_back(0);
+    ids.emplace(names.back(), id);
+    return id;
+}
+
+int BlockTable::find(std::string_view name) const {
+    auto found = ids.find(name);
+    return found == ids.end() ? -1 : found->second;
+}
+
+void BlockTable::finish(int start) {
+    int next = start;
+    for (int id = 0; id < size(); id++) {
+        lengths[id] = locations[id] - start;
+        start_addresses[id] = next;
+        next += lengths[id];
+    }
+    finished = true;
+}
+
+void BlockTable::restore(std::string_view name, int start_address, int length, int location) {
+    int id = use(name, location);
+    start_addresses[id] = start_address;
+    lengths[id] = length;
+    locations[id] = location;
+    finished = true;
+}
+
+bool BlockTable::dump(const std::string& filename) const {
+    std::ofstream out(filename);
+    if (!out.is_open())
+        return error("Unable to open file " + filename + " for writing.");
+    write(out);
+    return true;
+}
+
+void BlockTable::write(std::ostream& out) const {
+    // Same columns as the original block dump; until END, addresses and
+    // lengths are not known and read 0
+    if (names.empty()) {
+        out << "label\n";
+        return;
+    }
+    out << "label start_address length name\n";
+    for (int id = 0; id < size(); id++) {
+        out << id << ' ';
+        if (finished) {
+            out << std::uppercase << std::hex << std::setfill('0') << std::setw(4) << start_addresses[id] << ' '
+                << std::setw(4) << lengths[id] << std::dec << ' ';
+        } else {
+            out << "0 0 ";
+        }
+        out << names[id] << '\n';
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// USE blocks of a program, numbered in order of creation; block 0 is
+// DEFAULT. Names map to ids through a hash, and the location counter, start
+// address and length of every block live in dense arrays indexed by id, so
+// switching blocks and relocating an operand take constant time however
+// many blocks a program has.
+class BlockTable {
+public:
+    BlockTable() { clear(); }
+
+    void clear();                                   // No blocks; use("DEFAULT", ...) adds the first
+    // Id of block name, created with its location counter at start if new
+    int use(std::string_view name, int start);
+    int find(std::string_view name) const;          // Id or -1
+    int size() const { return static_cast<int>(names.size()); }
+
+    std::string_view name(int id) const { return names[id]; }
+    int& location(int id) { return locations[id]; }  // Location counter
+    int location(int id) const { return locations[id]; }
+    int startAddress(int id) const { return start_addresses[id]; }
+    int length(int id) const { return lengths[id]; }
+
+    // Once END is reached: every block's length is its counter minus start,
+    // and blocks are laid out one after another from start in id order
+    void finish(int start);
+    // Add a block as a finished program left it, e.g. from a cached layout
+    void restore(std::string_view name, int start_address, int length, int location);
+
+    bool dump(const std::string& filename) const;
+    void write(std::ostream& out) const;            // Same text as dump()
+
+private:
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const { return std::hash<std::string_view>()(name); }
+    };
+
+    std::vector<std::string> names;
+    std::vector<int> locations, start_addresses, lengths;
+    std::unordered_map<std::string, int, NameHash, std::equal_to<>> ids;
+    bool finished = false;                          // Start addresses and lengths are final
+};
+
+#endif // BLOCK_H
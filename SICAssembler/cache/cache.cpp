@@ -0,0 +1,120 @@
+#include "cache.h"
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+uint64_t hashBytes(std::string_view bytes, uint64_t hash) {
+    for (unsigned char c : bytes) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Copy or write to a unique temporary name, then rename it into place. The
+// process id keeps builds sharing a cache apart, whose main threads often
+// have the same id; the thread id keeps a batch's workers apart
+static std::string temporaryPath(const std::string& path) {
+    std::ostringstream name;
+    name << path << ".tmp" << getpid() << '.' << std::hash<std::thread::id>()(std::this_thread::get_id());
+    return name.str();
+}
+
+AssemblyCache::AssemblyCache(const std::string& directory) : directory(directory) {
+    std::error_code ignored;
+    fs::create_directories(directory, ignored);
+}
+
+std::string AssemblyCache::entryPath(uint64_t key, const std::string& suffix) const {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << suffix;
+    return (fs::path(directory) / name.str()).string();
+}
+
+bool AssemblyCache::fetchOutputs(uint64_t key, const std::string& baseName, const std::vector<std::string>& suffixes) const {
+    std::error_code status;
+    for (const std::string& suffix : suffixes) {
+        if (!fs::exists(entryPath(key, suffix), status))
+            return false;
+    }
+    for (const std::string& suffix : suffixes) {
+        fs::copy_file(entryPath(key, suffix), baseName + suffix, fs::copy_options::overwrite_existing, status);
+        if (status)
+            return false;
+    }
+    return true;
+}
+
+void AssemblyCache::storeOutputs(uint64_t key, const std::string& baseName, const std::vector<std::string>& suffixes) const {
+    std::error_code status;
+    for (const std::string& suffix : suffixes) {
+        std::string entry = entryPath(key, suffix), temporary = temporaryPath(entry);
+        fs::copy_file(baseName + suffix, temporary, fs::copy_options::overwrite_existing, status);
+        if (!status)
+            fs::rename(temporary, entry, status);
+    }
+}
+
+bool AssemblyCache::loadLayout(uint64_t key, CachedLayout& layout) const {
+    std::ifstream in(entryPath(key, ".layout"));
+    if (!in.is_open())
+        return false;
+
+    // Names are written last on their line so they may contain spaces
+    std::string tag;
+    size_t count;
+    if (!(in >> tag) || tag != "SICLAYOUT1")
+        return false;
+    in >> layout.start_address >> layout.program_length;
+    in.get();
+    std::getline(in, layout.program_name);
+
+    in >> tag >> count;
+    layout.blocks.resize(count);
+    for (CachedLayout::Block& block : layout.blocks) {
+        in >> block.start_address >> block.length >> block.location;
+        in.get();
+        std::getline(in, block.name);
+    }
+    in >> tag >> count;
+    layout.symbols.resize(count);
+    for (CachedLayout::Symbol& symbol : layout.symbols) {
+        in >> symbol.address >> symbol.block;
+        in.get();
+        std::getline(in, symbol.name);
+    }
+    in >> tag >> count;
+    layout.lines.resize(count);
+    for (CachedLayout::Line& line : layout.lines)
+        in >> line.location >> line.block;
+    return !in.fail();
+}
+
+void AssemblyCache::storeLayout(uint64_t key, const CachedLayout& layout) const {
+    std::string entry = entryPath(key, ".layout"), temporary = temporaryPath(entry);
+    {
+        std::ofstream out(temporary);
+        if (!out.is_open())
+            return;
+        out << "SICLAYOUT1 " << layout.start_address << " " << layout.program_length << " " << layout.program_name << "\n";
+        out << "blocks " << layout.blocks.size() << "\n";
+        for (const CachedLayout::Block& block : layout.blocks)
+            out << block.start_address << " " << block.length << " " << block.location << " " << block.name << "\n";
+        out << "symbols " << layout.symbols.size() << "\n";
+        for (const CachedLayout::Symbol& symbol : layout.symbols)
+            out << symbol.address << " " << symbol.block << " " << symbol.name << "\n";
+        out << "lines " << layout.lines.size() << "\n";
+        for (const CachedLayout::Line& line : layout.lines)
+            out << line.location << " " << line.block << "\n";
+        if (!out)
+            return;
+    }
+    std::error_code status;
+    fs::rename(temporary, entry, status);
+}
@@ -0,0 +1,61 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 64-bit FNV-1a, continuing from hash
+uint64_t hashBytes(std::string_view bytes, uint64_t hash = 14695981039346656037ull);
+
+// Everything pass1 computes that does not depend on instruction operands:
+// program header values, blocks, symbols and the location of every line
+struct CachedLayout {
+    struct Block {
+        std::string name;
+        int start_address;
+        int length;
+        int location;           // Final location counter value
+    };
+    struct Symbol {
+        std::string name;
+        int address;
+        int block;
+    };
+    struct Line {
+        int location;
+        int block;
+    };
+
+    std::string program_name;
+    int start_address = 0;
+    int program_length = 0;
+    std::vector<Block> blocks;
+    std::vector<Symbol> symbols;
+    std::vector<Line> lines;
+};
+
+// Persistent on-disk cache of assembler results. Finished outputs are kept
+// under the hash of the source and optab; pass1 layouts are kept under the
+// hash of the location-affecting part of the source. Entries are written to
+// a temporary file and renamed into place, so concurrent assemblies can
+// share one cache directory.
+class AssemblyCache {
+public:
+    explicit AssemblyCache(const std::string& directory);
+
+    // Copy the cached outputs for key next to baseName; false on a miss
+    bool fetchOutputs(uint64_t key, const std::string& baseName, const std::vector<std::string>& suffixes) const;
+    void storeOutputs(uint64_t key, const std::string& baseName, const std::vector<std::string>& suffixes) const;
+
+    bool loadLayout(uint64_t key, CachedLayout& layout) const;
+    void storeLayout(uint64_t key, const CachedLayout& layout) const;
+
+private:
+    std::string directory;
+
+    std::string entryPath(uint64_t key, const std::string& suffix) const;
+};
+
+#endif // CACHE_H
@@ -1,12 +1,163 @@
-#include "SICasm.h"
+#include "SICXEasm.h"
+#include "batch.h"
+#include "error.h"
+#include "serve.h"
+#include <charconv>
+#include <cstdlib>
 #include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Set by --stats before any thread starts, and never cleared
+bool countingAllocations = false;
+
+} // namespace
+
+// Replacements for the global allocation functions that feed the --stats
+// counters; array and nothrow forms forward here in libstdc++. They are part
+// of the command-line tool only, so programs using libsicasm.a keep their own
+// allocator.
+void* operator new(std::size_t size) {
+    if (countingAllocations)
+        countAllocation(size);
+    if (void* block = std::malloc(size ? size : 1))
+        return block;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept {
+    std::free(block);
+}
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
+    std::vector<std::string> files;
+    std::string opcodeFile;
+    AssemblerOptions options;
+    bool batch = false;
+    bool loadAndGo = false;
+    StatsFormat statsFormat = StatsFormat::NONE;
+    unsigned jobs = 0;
+    std::string serveSocket, connectSocket;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--intermediate") {
+            options.intermediate = true; // Keep the decoded pass1 output for debugging
+        } else if (arg == "--sicxe") {
+            options.machine = Machine::SICXE; // Formats 1 to 4, relaxed to the shortest that fits
+        } else if (arg == "--optab" && i + 1 < argc) {
+            opcodeFile = argv[++i];      // Replace the built-in opcode table
+        } else if (arg == "--format" && i + 1 < argc) {
+            std::string format = argv[++i]; // Object file format
+            if (format == "text") options.object_format = ObjectFormat::TEXT;
+            else if (format == "binary") options.object_format = ObjectFormat::BINARY;
+            else if (format == "both") options.object_format = ObjectFormat::BOTH;
+            else {
+                std::cerr << "Invalid Argument";
+                return 1;
+            }
+        } else if (arg == "--dumps" && i + 1 < argc) {
+            std::string dumps = argv[++i];  // Symbol and block tables
+            if (dumps == "text") options.dumps = DumpFormat::TEXT;
+            else if (dumps == "snapshot") options.dumps = DumpFormat::SNAPSHOT;
+            else if (dumps == "none") options.dumps = DumpFormat::NONE;
+            else {
+                std::cerr << "Invalid Argument";
+                return 1;
+            }
+        } else if (arg == "--xref") {
+            options.cross_reference = true; // Index where every symbol is defined and used
+        } else if (arg == "--cache" && i + 1 < argc) {
+            options.cache_dir = argv[++i]; // Reuse results of earlier runs
+        } else if (arg == "--stats") {
+            statsFormat = StatsFormat::TEXT; // Report timings and counters on stderr
+        } else if (arg == "--stats=json") {
+            statsFormat = StatsFormat::JSON;
+        } else if (arg == "--diagnostics=json") {
+            options.diagnostic_format = DiagnosticFormat::JSON; // Errors and warnings as one JSON line per file
+        } else if (arg == "--load-and-go") {
+            loadAndGo = true;            // One pass into memory, only the object file is written
+        } else if (arg == "--batch") {
+            batch = true;                // Assemble every listed file concurrently
+        } else if (arg == "--manifest" && i + 1 < argc) {
+            batch = true;
+            if (!readManifest(argv[++i], files))
+                return 1;
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serveSocket = argv[++i];     // Run as a daemon on this Unix socket
+        } else if (arg == "--connect" && i + 1 < argc) {
+            connectSocket = argv[++i];   // Let a running daemon do the work
+        } else if (arg == "-j" && i + 1 < argc) {
+            std::string_view count = argv[++i];
+            auto [end, status] = std::from_chars(count.data(), count.data() + count.size(), jobs);
+            if (status != std::errc() || end != count.data() + count.size()) {
+                error("Invalid thread count: " + std::string(count));
+                return 1;
+            }
+        } else {
+            files.push_back(arg);
+        }
+    }
+    countingAllocations = statsFormat != StatsFormat::NONE;
+    if (serveSocket.empty() && (files.empty() || (!batch && files.size() != 1))) {
         std::cerr << "Invalid Argument";
         return 1;
     }
-    SIC_assembler sic("../sic/opcode");
-    sic.assemble(argv[1]);
-    return 0;
+
+    Optab customOptab;
+    if (!opcodeFile.empty() && !customOptab.load(opcodeFile))
+        return 1;
+    const Optab& builtin = options.machine == Machine::SICXE ? Optab::builtinXE() : Optab::builtin();
+    const Optab& optab = opcodeFile.empty() ? builtin : customOptab;
+
+    if (!serveSocket.empty())
+        return serve(serveSocket, optab, options, jobs ? jobs : std::thread::hardware_concurrency()) ? 0 : 1;
+    if (batch)
+        return assembleBatch(files, optab, options, jobs ? jobs : std::thread::hardware_concurrency(), statsFormat) ? 0 : 1;
+
+    // Scripts can opt into a running daemon through the environment; without
+    // one answering, the file is assembled here. The daemon only takes the
+    // source and the output options, so a run with anything it would drop
+    // (statistics, load-and-go, the cache, the intermediate file or another
+    // opcode table) stays local
+    const char* socketVariable = std::getenv("SIC_ASSEMBLER_SOCKET");
+    bool remoteCapable = files[0] != "-" && !loadAndGo && statsFormat == StatsFormat::NONE &&
+                         options.cache_dir.empty() && !options.intermediate && opcodeFile.empty();
+    if (connectSocket.empty() && socketVariable)
+        connectSocket = socketVariable;
+    if (!connectSocket.empty() && remoteCapable) {
+        bool ok;
+        if (assembleRemote(connectSocket, files[0], options, ok))
+            return ok ? 0 : 1;
+        if (!socketVariable || connectSocket != socketVariable) {
+            error("Could not connect to " + connectSocket);
+            return 1;
+        }
+    }
+
+    options.threads = jobs ? jobs : std::thread::hardware_concurrency();
+    std::unique_ptr<Assembler> sic = makeAssembler(optab, options);
+    if (files[0] == "-") {
+        // Read the source from stdin and write the object program to stdout
+        std::ios::sync_with_stdio(false);
+        bool ok = sic->assembleStream(std::cin, STDOUT_FILENO);
+        printStats(std::cerr, "-", sic->statistics(), statsFormat);
+        return ok ? 0 : 1;
+    }
+    if (loadAndGo) {
+        bool ok = sic->loadAndGo(files[0]);
+        printStats(std::cerr, files[0], sic->statistics(), statsFormat);
+        return ok ? 0 : 1;
+    }
+    bool ok = sic->assemble(files[0]);
+    printStats(std::cerr, files[0], sic->statistics(), statsFormat);
+    return ok ? 0 : 1;
 }
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include "diagnostics.h"
+#include "stats.h"
+
+void Diagnostics::begin(std::string_view name, std::string_view source) {
+    file = name;
+    text = source;
+    line_starts.clear();
+    list.clear();
+    error_count = 0;
+}
+
+void Diagnostics::add(Severity severity, std::string message, int line, std::string_view at) {
+    int column = 0;
+    const char* begin = text.data();
+    if (!at.empty() && at.data() >= begin && at.data() < begin + text.size()) {
+        if (line_starts.empty()) {
+            line_starts.push_back(0);
+            for (size_t i = text.find('\n'); i != std::string_view::npos; i = text.find('\n', i + 1))
+                line_starts.push_back(i + 1);
+        }
+        size_t offset = at.data() - begin;
+        auto next = std::upper_bound(line_starts.begin(), line_starts.end(), offset);
+        line = static_cast<int>(next - line_starts.begin());
+        column = static_cast<int>(offset - *(next - 1)) + 1;
+    }
+    list.push_back(Diagnostic{severity, line, column, std::move(message)});
+    if (severity == Severity::ERROR)
+        error_count++;
+}
+
+bool Diagnostics::error(std::string message, int line, std::string_view at) {
+    add(Severity::ERROR, std::move(message), line, at);
+    return false;
+}
+
+void Diagnostics::warning(std::string message, int line, std::string_view at) {
+    add(Severity::WARNING, std::move(message), line, at);
+}
+
+void Diagnostics::add(Diagnostic diagnostic) {
+    if (diagnostic.severity == Severity::ERROR)
+        error_count++;
+    list.push_back(std::move(diagnostic));
+}
+
+std::string Diagnostics::format(const Diagnostic& diagnostic) const {
+    std::string out = file;
+    if (diagnostic.line > 0) {
+        out += (out.empty() ? "" : ":") + std::to_string(diagnostic.line);
+        if (diagnostic.column > 0)
+            out += ":" + std::to_string(diagnostic.column);
+    }
+    out += out.empty() ? "" : ": ";
+    out += diagnostic.severity == Severity::ERROR ? "error: " : "warning: ";
+    return out + diagnostic.message;
+}
+
+void Diagnostics::write(std::ostream& out, DiagnosticFormat style) {
+    // Passes report in their own order; readers want the source order
+    std::stable_sort(list.begin(), list.end(),
+                     [](const Diagnostic& a, const Diagnostic& b) { return a.line < b.line; });
+    if (style == DiagnosticFormat::TEXT) {
+        for (const Diagnostic& diagnostic : list)
+            out << format(diagnostic) << '\n';
+        out.flush();
+        return;
+    }
+
+    // One object per line, like --stats=json
+    out << "{\"file\":" << jsonString(file) << ",\"errors\":" << errors() << ",\"warnings\":" << warnings()
+        << ",\"diagnostics\":[";
+    for (size_t i = 0; i < list.size(); i++) {
+        const Diagnostic& diagnostic = list[i];
+        out << (i ? "," : "") << "{\"severity\":\"" << (diagnostic.severity == Severity::ERROR ? "error" : "warning")
+            << "\",\"line\":" << diagnostic.line << ",\"column\":" << diagnostic.column
+            << ",\"message\":" << jsonString(diagnostic.message) << "}";
+    }
+    out << "]}" << std::endl;
+}
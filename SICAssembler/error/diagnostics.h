@@ -0,0 +1,53 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class DiagnosticFormat { TEXT, JSON };
+enum class Severity : unsigned char { ERROR, WARNING };
+
+struct Diagnostic {
+    Severity severity;
+    int line;                   // 1-based, 0 for the program as a whole
+    int column;                 // 1-based, 0 if not known
+    std::string message;
+};
+
+// Errors and warnings of one assembly. The passes record a problem and go
+// on with the next line, so one run reports everything; nothing is printed
+// until write(). A problem is placed by a token view into the source: its
+// line and column are looked up then, from a line index built on the first
+// report, so clean lines pay nothing. Tokens from elsewhere (macro
+// expansions) fall back to the line given by the caller.
+class Diagnostics {
+public:
+    // Start over for a source; text is what token views point into
+    void begin(std::string_view file, std::string_view text);
+    bool error(std::string message, int line = 0, std::string_view at = {});    // Always false
+    void warning(std::string message, int line = 0, std::string_view at = {});
+    // A diagnostic placed elsewhere, such as one a daemon sent back
+    void add(Diagnostic diagnostic);
+
+    size_t errors() const { return error_count; }
+    size_t warnings() const { return list.size() - error_count; }
+    const std::vector<Diagnostic>& all() const { return list; }
+
+    // file:line:column: error: message, leaving out what is not known
+    std::string format(const Diagnostic& diagnostic) const;
+    // Every diagnostic in source order, as text lines or one JSON object
+    void write(std::ostream& out, DiagnosticFormat style);
+
+private:
+    std::string file;
+    std::string_view text;
+    std::vector<size_t> line_starts;    // Offset of every line in text, built on demand
+    std::vector<Diagnostic> list;
+    size_t error_count = 0;
+
+    void add(Severity severity, std::string message, int line, std::string_view at);
+};
+
+#endif // DIAGNOSTICS_H
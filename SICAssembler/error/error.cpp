@@ -1,7 +1,20 @@
 #include <iostream>
 #include <string>
+#include "error.h"
+
+// Each thread can collect its own diagnostics, e.g. one buffer per batch task
+static thread_local std::ostream* redirected = nullptr;
 
 bool error(std::string msg){
-    std::cerr << "Error: " << msg << std::endl;
+    std::ostream& out = redirected ? *redirected : std::cerr;
+    out << "Error: " << msg << std::endl;
     return false;
 }
+
+void setErrorStream(std::ostream* stream){
+    redirected = stream;
+}
+
+std::ostream* errorStream(){
+    return redirected;
+}
@@ -2,7 +2,12 @@
 #define ERROR_H
 
 #include <string>
+#include <ostream>
 
 bool error(std::string msg);
 
+// Redirect error() output of the calling thread, nullptr restores stderr
+void setErrorStream(std::ostream* stream);
+std::ostream* errorStream();    // Current redirection, nullptr for stderr
+
 #endif //ERROR_H
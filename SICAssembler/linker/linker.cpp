@@ -0,0 +1,285 @@
+// Linking loader: combines the control sections of many object files into
+// one absolute object program.
+//
+//   pass 1  give every section a load address, one after another from
+//           --address, and enter section names and D symbols in the
+//           external symbol table (ESTAB)
+//   pass 2  copy every section's text to its load address and apply its
+//           modification records from ESTAB
+//
+// Object files are parsed and sections relocated in parallel; ESTAB is a
+// hashed symbol table, so lookups stay constant time with many modules.
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "binary.h"
+#include "error.h"
+#include "pool.h"
+#include "source.h"
+#include "symtab.h"
+
+namespace {
+
+struct Module {
+    std::string filename;
+    std::vector<ObjectSection> sections;
+    std::vector<int> load_address;      // Per section, set by pass 1
+    bool ok = false;
+    std::string diagnostics;
+};
+
+bool loadModule(Module& module) {
+    SourceFile file;
+    if (!file.open(module.filename))
+        return error("Could not open file " + module.filename);
+    if (isBinaryObject(file.text())) {
+        // A .sicb file is one absolute section without linkage records
+        module.sections.emplace_back();
+        module.sections.back().has_entry = true;
+        return readBinaryObject(module.filename, module.sections.back().program);
+    }
+    if (!readLinkableObject(file.text(), module.sections))
+        return false;
+    if (module.sections.empty())
+        return error("No header record in " + module.filename);
+    return true;
+}
+
+// Apply one modification record to the field at image[offset]
+bool modify(std::vector<unsigned char>& image, size_t offset, const ObjectModification& modification, int value) {
+    size_t size = (modification.half_bytes + 1) / 2;
+    if (offset + size > image.size())
+        return false;
+    uint32_t word = 0;
+    for (size_t i = 0; i < size; i++)
+        word = word << 8 | image[offset + i];
+    uint32_t mask = (uint32_t(1) << (4 * modification.half_bytes)) - 1;
+    uint32_t field = word & mask;
+    field = modification.negative ? field - value : field + value;
+    word = (word & ~mask) | (field & mask);
+    for (size_t i = size; i-- > 0; word >>= 8)
+        image[offset + i] = static_cast<unsigned char>(word);
+    return true;
+}
+
+// Parse all of text as a number; false on anything else
+template <typename T>
+bool parseNumber(std::string_view text, T& value, int base = 10) {
+    auto [end, status] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+    return status == std::errc() && end != text.data() && end == text.data() + text.size();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> files;
+    std::string output = "a.obj";
+    int program_address = 0;
+    unsigned jobs = std::thread::hardware_concurrency();
+    bool binary = false, map = false, stats = false;
+    bool usage = false;
+    for (int i = 1; i < argc && !usage; i++) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc)
+            output = argv[++i];
+        else if (arg == "--address" && i + 1 < argc)
+            usage = !parseNumber(argv[++i], program_address, 16) || program_address < 0;
+        else if (arg == "-j" && i + 1 < argc)
+            usage = !parseNumber(argv[++i], jobs) || jobs == 0;
+        else if (arg == "--binary")
+            binary = true;              // Write .sicb instead of text records
+        else if (arg == "--map")
+            map = true;                 // Print the load map on stdout
+        else if (arg == "--stats")
+            stats = true;
+        else
+            files.push_back(arg);
+    }
+    if (usage || files.empty()) {
+        std::cerr << "Usage: sic_link [-o output] [--address hex] [--binary] [--map] [--stats] [-j threads] <object files>\n";
+        return 1;
+    }
+    auto started = std::chrono::steady_clock::now();
+
+    // Parse every object file in parallel, reporting errors in input order
+    std::vector<Module> modules(files.size());
+    ThreadPool pool(jobs);
+    for (size_t i = 0; i < files.size(); i++) {
+        modules[i].filename = files[i];
+        pool.submit([&modules, i] {
+            std::ostringstream diagnostics;
+            setErrorStream(&diagnostics);
+            modules[i].ok = loadModule(modules[i]);
+            setErrorStream(nullptr);
+            modules[i].diagnostics = diagnostics.str();
+        });
+    }
+    pool.wait();
+    bool ok = true;
+    for (const Module& module : modules) {
+        std::cerr << module.diagnostics;
+        ok = ok && module.ok;
+    }
+    if (!ok)
+        return 1;
+
+    // Pass 1: load addresses and ESTAB. Symbols are keyed by name only;
+    // the block field holds the index of the defining module.
+    SymbolTable estab;
+    int address = program_address;
+    size_t sectionCount = 0, modificationCount = 0;
+    for (size_t m = 0; m < modules.size(); m++) {
+        Module& module = modules[m];
+        for (const ObjectSection& section : module.sections) {
+            const ObjectProgram& program = section.program;
+            module.load_address.push_back(address);
+            int delta = address - program.start_address;
+            auto define = [&](const std::string& name, int value) {
+                int id = estab.intern(name);
+                if (estab.defined(id))
+                    return error("Duplicate external symbol " + name + " in " + module.filename);
+                estab.define(id, value, static_cast<int>(m));
+                return true;
+            };
+            if (!define(program.name, address))
+                ok = false;
+            for (const auto& [name, value] : section.definitions) {
+                // A section may export its own name; ESTAB already has it
+                if (name == program.name && value + delta == address)
+                    continue;
+                if (!define(name, value + delta))
+                    ok = false;
+            }
+            address += program.program_length;
+            sectionCount++;
+            modificationCount += section.modifications.size();
+        }
+    }
+    if (!ok)
+        return 1;
+
+    // Pass 2: every section writes only its own part of the image, so the
+    // sections are relocated in parallel
+    int program_length = address - program_address;
+    std::vector<unsigned char> image(program_length);
+    std::vector<std::string> diagnostics(modules.size());
+    for (size_t m = 0; m < modules.size(); m++) {
+        pool.submit([&, m] {
+            std::ostringstream messages;
+            setErrorStream(&messages);
+            const Module& module = modules[m];
+            for (size_t s = 0; s < module.sections.size(); s++) {
+                const ObjectSection& section = module.sections[s];
+                const ObjectProgram& program = section.program;
+                int base = module.load_address[s] - program_address;
+                int delta = module.load_address[s] - program.start_address;
+                auto inside = [&](int address, size_t size) {
+                    return address >= program.start_address &&
+                           address + static_cast<int>(size) <= program.start_address + program.program_length;
+                };
+                for (const ObjectSegment& segment : program.segments) {
+                    if (!inside(segment.address, segment.bytes.size())) {
+                        error("Text outside section " + program.name + " in " + module.filename);
+                        continue;
+                    }
+                    std::copy(segment.bytes.begin(), segment.bytes.end(),
+                              image.begin() + base + (segment.address - program.start_address));
+                }
+                for (const ObjectModification& modification : section.modifications) {
+                    int value;
+                    if (modification.symbol == program.name) {
+                        value = delta;      // Relocation within the section itself
+                    } else {
+                        int id = estab.find(modification.symbol);
+                        if (id == SymbolTable::npos || !estab.defined(id)) {
+                            error("Undefined external symbol " + modification.symbol + " in " + module.filename);
+                            continue;
+                        }
+                        value = estab.address(id);
+                    }
+                    size_t size = (modification.half_bytes + 1) / 2;
+                    if (!inside(modification.address, size) ||
+                        !modify(image, base + (modification.address - program.start_address), modification, value))
+                        error("Modification outside section " + program.name + " in " + module.filename);
+                }
+            }
+            setErrorStream(nullptr);
+            diagnostics[m] = messages.str();
+        });
+    }
+    pool.wait();
+    for (const std::string& messages : diagnostics) {
+        std::cerr << messages;
+        ok = ok && messages.empty();
+    }
+    if (!ok)
+        return 1;
+
+    // The linked program keeps the text records' layout, now at absolute
+    // addresses; the entry point is the first one an E record gives
+    ObjectProgram linked;
+    linked.name = modules[0].sections[0].program.name;
+    linked.start_address = program_address;
+    linked.program_length = program_length;
+    linked.entry_address = program_address;
+    bool entryFound = false;
+    for (const Module& module : modules) {
+        for (size_t s = 0; s < module.sections.size(); s++) {
+            const ObjectSection& section = module.sections[s];
+            int delta = module.load_address[s] - section.program.start_address;
+            if (section.has_entry && !entryFound) {
+                linked.entry_address = section.program.entry_address + delta;
+                entryFound = true;
+            }
+            for (const ObjectSegment& segment : section.program.segments) {
+                int offset = segment.address + delta - program_address;
+                linked.addBytes(segment.address + delta, image.data() + offset, segment.bytes.size());
+            }
+        }
+    }
+    if (binary) {
+        if (!writeBinaryObject(output, linked))
+            return 1;
+    } else {
+        std::ofstream out(output);
+        if (!out.is_open()) {
+            error("Could not create " + output);
+            return 1;
+        }
+        out << formatTextObject(linked);
+    }
+
+    if (map) {
+        // Load map: every section with its address and length, then its symbols
+        std::cout << std::uppercase << std::hex << std::setfill('0');
+        for (size_t m = 0; m < modules.size(); m++) {
+            const Module& module = modules[m];
+            for (size_t s = 0; s < module.sections.size(); s++) {
+                const ObjectSection& section = module.sections[s];
+                int delta = module.load_address[s] - section.program.start_address;
+                std::cout << std::left << std::setw(6) << std::setfill(' ') << section.program.name << std::right
+                          << std::setfill('0') << "        " << std::setw(6) << module.load_address[s]
+                          << " " << std::setw(6) << section.program.program_length << "\n";
+                for (const auto& [name, value] : section.definitions)
+                    std::cout << "       " << std::left << std::setw(6) << std::setfill(' ') << name << std::right
+                              << " " << std::setfill('0') << std::setw(6) << value + delta << "\n";
+            }
+        }
+    }
+    if (stats) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::cerr << std::fixed << std::setprecision(3)
+                  << "Linked " << modules.size() << " files, " << sectionCount << " sections, "
+                  << estab.size() << " external symbols and " << modificationCount << " modifications into "
+                  << program_length << " bytes with " << pool.size() << " threads in " << seconds * 1000 << " ms" << std::endl;
+    }
+    return 0;
+}
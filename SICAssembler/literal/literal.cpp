@@ -0,0 +1,82 @@
+#include <charconv>
+#include "literal.h"
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Bytes of a literal, as BYTE or WORD would assemble it
+static bool decodeValue(std::string_view text, std::string& value, bool& word) {
+    value.clear();
+    word = false;
+    if (text.size() >= 3 && text[1] == '\'' && text.back() == '\'') {
+        std::string_view constant = text.substr(2, text.size() - 3);
+        if (text[0] == 'C' || text[0] == 'c') {
+            value = constant;
+            return !constant.empty();
+        }
+        if (text[0] == 'X' || text[0] == 'x') {
+            // An odd digit count gets a leading zero
+            bool highNibble = constant.size() % 2 == 0;
+            int byte = 0;
+            for (char c : constant) {
+                int digit = hexDigit(c);
+                if (digit < 0)
+                    return false;
+                if (highNibble) {
+                    byte = digit << 4;
+                } else {
+                    value += static_cast<char>(byte | digit);
+                }
+                highNibble = !highNibble;
+            }
+            return !constant.empty();
+        }
+        return false;
+    }
+    int number;
+    auto [end, status] = std::from_chars(text.data(), text.data() + text.size(), number);
+    if (status != std::errc() || end != text.data() + text.size())
+        return false;
+    word = true;
+    value += static_cast<char>(number >> 16);
+    value += static_cast<char>(number >> 8);
+    value += static_cast<char>(number);
+    return true;
+}
+
+bool LiteralTable::add(std::string_view text, int& id) {
+    bool word;
+    if (!decodeValue(text, value, word))
+        return false;
+    auto found = values.find(std::string_view(value));
+    if (found != values.end()) {
+        reused++;
+        id = found->second;
+        return true;
+    }
+    id = static_cast<int>(literals.size());
+    literals.push_back(Literal{text, word});
+    pool.push_back(id);
+    values.emplace(value, id);
+    return true;
+}
+
+void LiteralTable::place(int id, int location, int block) {
+    literals[id].location = location;
+    literals[id].block = block;
+}
+
+void LiteralTable::closePool() {
+    pool.clear();
+    values.clear();
+}
+
+void LiteralTable::clear() {
+    literals.clear();
+    closePool();
+    reused = 0;
+}
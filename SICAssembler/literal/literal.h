@@ -0,0 +1,53 @@
+#ifndef LITERAL_H
+#define LITERAL_H
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Literal operands (=C'EOF', =X'05', =3). Literals collect in a pool until
+// LTORG or END places it; within one pool, literals with the same value
+// share a single entry, whatever form they were written in, so =3 and
+// =X'000003' take three bytes once. Literals are not symbols and do not
+// appear in the symbol table.
+class LiteralTable {
+public:
+    // Id of the literal written as text (without the '='), reusing an entry
+    // of the open pool with the same value. False if text is malformed.
+    bool add(std::string_view text, int& id);
+
+    // Literals of the open pool in order of first use
+    const std::vector<int>& pending() const { return pool; }
+    void place(int id, int location, int block);
+    void closePool();                       // Placed literals start a new pool
+
+    std::string_view text(int id) const { return literals[id].text; }
+    bool isWord(int id) const { return literals[id].word; }    // =n, assembled like WORD
+    int location(int id) const { return literals[id].location; }
+    int block(int id) const { return literals[id].block; }
+    size_t size() const { return literals.size(); }
+    size_t shared() const { return reused; }   // Operands that reused an entry
+    void clear();
+
+private:
+    struct Literal {
+        std::string_view text;      // View into the source text
+        bool word;
+        int location = -1;          // Block-relative, -1 until placed
+        int block = 0;
+    };
+    struct ValueHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view value) const { return std::hash<std::string_view>()(value); }
+    };
+
+    std::vector<Literal> literals;
+    std::vector<int> pool;
+    std::unordered_map<std::string, int, ValueHash, std::equal_to<>> values;   // Open pool by value
+    std::string value;              // Reused to decode each literal
+    size_t reused = 0;
+};
+
+#endif // LITERAL_H
@@ -0,0 +1,222 @@
+#include "macro.h"
+#include "optab.h"
+
+static bool isNameChar(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// Split a comma separated list, keeping empty entries so positions hold
+static void splitList(std::string_view list, std::vector<std::string_view>& items) {
+    items.clear();
+    if (list.empty())
+        return;
+    for (;;) {
+        size_t comma = list.find(',');
+        items.push_back(list.substr(0, comma));
+        if (comma == std::string_view::npos)
+            return;
+        list.remove_prefix(comma + 1);
+    }
+}
+
+int MacroTable::find(std::string_view name) const {
+    auto found = names.find(name);
+    return found == names.end() ? -1 : found->second;
+}
+
+bool MacroTable::define(std::string_view name, std::string_view parameters, std::string& problem) {
+    if (name.empty()) {
+        problem = "MACRO needs a name";
+        return false;
+    }
+    if (find(name) >= 0) {
+        problem = "Duplicate macro definition: " + std::string(name);
+        return false;
+    }
+    Macro macro;
+    macro.name = name;
+    splitList(parameters, macro.parameters);
+    for (std::string_view parameter : macro.parameters) {
+        if (parameter.size() < 2 || parameter[0] != '&') {
+            problem = "Invalid parameter of macro " + macro.name + ": " + std::string(parameter);
+            return false;
+        }
+    }
+    names.emplace(macro.name, static_cast<int>(macros.size()));
+    macros.push_back(std::move(macro));
+    return true;
+}
+
+MacroTable::Field MacroTable::compile(std::string_view text, const Macro& macro) const {
+    Field field{text, {}};
+    size_t literal = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] != '&')
+            continue;
+        size_t end = i + 1;
+        while (end < text.size() && isNameChar(text[end]))
+            end++;
+        std::string_view name = text.substr(i, end - i);
+        for (size_t p = 0; p < macro.parameters.size(); p++) {
+            if (macro.parameters[p] != name)
+                continue;
+            if (i > literal)
+                field.pieces.push_back(Piece{text.substr(literal, i - literal), -1});
+            field.pieces.push_back(Piece{{}, static_cast<int>(p)});
+            literal = end;
+            break;
+        }
+        i = end - 1;
+    }
+    if (!field.pieces.empty() && literal < text.size())
+        field.pieces.push_back(Piece{text.substr(literal), -1});
+    return field;
+}
+
+void MacroTable::addLine(const SourceLine& line) {
+    Macro& macro = macros.back();
+    macro.body.push_back(Line{line.labelled, compile(line.label, macro), compile(line.operation, macro),
+                              compile(line.operand, macro)});
+}
+
+const std::vector<SourceLine>* MacroTable::expand(int id, std::string_view arguments, std::string& problem) {
+    key.assign(reinterpret_cast<const char*>(&id), sizeof(id));
+    key.append(arguments);
+    auto found = memo.find(key);
+    if (found != memo.end()) {
+        hits++;
+        return &found->second.lines;
+    }
+
+    const Macro& macro = macros[id];
+    std::vector<std::string_view> values;
+    splitList(arguments, values);
+    if (values.size() > macro.parameters.size()) {
+        problem = "Too many arguments for macro " + macro.name + ": " + std::string(arguments);
+        return nullptr;
+    }
+    values.resize(macro.parameters.size());     // Missing arguments are empty
+
+    // Build in place: the map's nodes never move, so views into the
+    // expansion's text stay valid once it is complete
+    Expansion& expansion = memo[key];
+    struct Span {
+        size_t offset, length;
+    };
+    std::vector<Span> spans;
+    auto substitute = [&](const Field& field) {
+        if (field.pieces.empty())
+            return;
+        Span span{expansion.text.size(), 0};
+        for (const Piece& piece : field.pieces)
+            expansion.text.append(piece.parameter < 0 ? piece.text : values[piece.parameter]);
+        span.length = expansion.text.size() - span.offset;
+        spans.push_back(span);
+    };
+    for (const Line& line : macro.body) {
+        substitute(line.label);
+        substitute(line.operation);
+        substitute(line.operand);
+    }
+
+    size_t next = 0;
+    auto view = [&](const Field& field) {
+        if (field.pieces.empty())
+            return field.text;
+        const Span& span = spans[next++];
+        return std::string_view(expansion.text).substr(span.offset, span.length);
+    };
+    expansion.lines.reserve(macro.body.size());
+    for (const Line& line : macro.body) {
+        SourceLine tokens;
+        tokens.label = view(line.label);
+        tokens.operation = view(line.operation);
+        tokens.operand = view(line.operand);
+        tokens.labelled = line.labelled && !tokens.label.empty();
+        expansion.lines.push_back(tokens);
+    }
+    expanded++;
+    return &expansion.lines;
+}
+
+void MacroTable::clear() {
+    macros.clear();
+    names.clear();
+    memo.clear();
+    expanded = hits = 0;
+}
+
+void MacroReader::fail(std::string message, std::string_view at) {
+    error_seen = true;
+    diagnostics.error(std::move(message), static_cast<int>(lines_read), at);
+}
+
+bool MacroReader::next(SourceLine& tokens) {
+    std::string problem;
+    for (;;) {
+        bool fromSource = stack.empty();
+        if (!fromSource) {
+            Frame& frame = stack.back();
+            if (frame.next == frame.lines->size()) {
+                stack.pop_back();
+                continue;
+            }
+            tokens = (*frame.lines)[frame.next++];
+        } else {
+            std::string_view line;
+            if (!reader.next(line))
+                return false;
+            lines_read++;
+            tokens = splitLine(line);
+        }
+
+        if (equalsIgnoreCase(tokens.operation, "MACRO")) {
+            if (!fromSource) {
+                fail("Macro definition inside a macro body: " + std::string(tokens.label), tokens.operation);
+                continue;
+            }
+            // The body runs up to MEND and is stored, not assembled. The body
+            // of an invalid definition is skipped all the same.
+            bool defined = macros.define(tokens.label, tokens.operand, problem);
+            if (!defined)
+                fail(problem, tokens.operation);
+            std::string_view line;
+            for (;;) {
+                if (!reader.next(line)) {
+                    fail("Missing MEND for macro " + std::string(tokens.label), tokens.operation);
+                    return false;
+                }
+                lines_read++;
+                SourceLine body = splitLine(line);
+                if (equalsIgnoreCase(body.operation, "MEND"))
+                    break;
+                if (equalsIgnoreCase(body.operation, "MACRO"))
+                    fail("Macro definition inside a macro body: " + std::string(body.label), body.operation);
+                else if (defined && (body.labelled || !body.operation.empty()))
+                    macros.addLine(body);
+            }
+            continue;
+        }
+        if (equalsIgnoreCase(tokens.operation, "MEND")) {
+            fail("MEND without MACRO", tokens.operation);
+            continue;
+        }
+
+        int id = macros.empty() || tokens.operation.empty() ? -1 : macros.find(tokens.operation);
+        if (id < 0)
+            return true;
+        // A failed invocation is dropped, apart from its label
+        const std::vector<SourceLine>* lines = nullptr;
+        if (stack.size() == MAX_DEPTH)
+            fail("Macro invocations nested too deeply: " + std::string(tokens.operation), tokens.operation);
+        else if (!(lines = macros.expand(id, tokens.operand, problem)))
+            fail(problem, tokens.operand);
+        if (lines)
+            stack.push_back(Frame{lines, 0});
+        if (tokens.labelled) {
+            tokens.operation = std::string_view();
+            tokens.operand = std::string_view();
+            return true;
+        }
+    }
+}
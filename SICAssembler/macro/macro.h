@@ -0,0 +1,109 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "diagnostics.h"
+#include "source.h"
+
+// Macro definitions and their expansions. A definition
+//
+//   NAME:  MACRO   &A,&B
+//          ...     body lines using &A and &B anywhere in a field
+//          MEND
+//
+// is kept as tokenized body lines, with each field that mentions a parameter
+// split into literal pieces and parameter numbers. Expanding a macro fills in
+// the arguments; the lines of every distinct argument list are built once and
+// handed out again for later invocations with the same arguments.
+class MacroTable {
+public:
+    int find(std::string_view name) const;     // Macro id or -1
+    bool empty() const { return macros.empty(); }
+    size_t size() const { return macros.size(); }
+
+    // Start defining macro name; parameters is the comma separated list.
+    // Body lines are views into the source text, which must outlive the table.
+    // False with the reason in problem if the definition is invalid.
+    bool define(std::string_view name, std::string_view parameters, std::string& problem);
+    void addLine(const SourceLine& line);       // Next body line of the open definition
+
+    // Lines of macro id for the comma separated arguments, or nullptr with
+    // the reason in problem; the lines stay valid until clear().
+    const std::vector<SourceLine>* expand(int id, std::string_view arguments, std::string& problem);
+
+    void clear();
+    size_t expansions() const { return expanded; }  // Argument lists expanded
+    size_t memoHits() const { return hits; }        // Invocations served from earlier expansions
+
+private:
+    struct Piece {
+        std::string_view text;      // Literal text, used when parameter < 0
+        int parameter;
+    };
+    struct Field {
+        std::string_view text;      // The field itself when it names no parameter
+        std::vector<Piece> pieces;  // Empty when the field is literal
+    };
+    struct Line {
+        bool labelled;
+        Field label, operation, operand;
+    };
+    struct Macro {
+        std::string name;
+        std::vector<std::string_view> parameters;
+        std::vector<Line> body;
+    };
+    struct Expansion {
+        std::string text;           // Storage of the substituted fields
+        std::vector<SourceLine> lines;
+    };
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const { return std::hash<std::string_view>()(name); }
+    };
+
+    std::vector<Macro> macros;
+    std::unordered_map<std::string, int, NameHash, std::equal_to<>> names;
+    std::unordered_map<std::string, Expansion> memo;   // Keyed by macro id and arguments
+    std::string key;                                   // Reused to build memo keys
+    size_t expanded = 0, hits = 0;
+
+    Field compile(std::string_view text, const Macro& macro) const;
+};
+
+// Source lines as pass1 sees them: definitions are recorded in the macro
+// table and taken out, invocations are replaced by their expansions. The
+// label of an invocation comes back as a line of its own, so it names the
+// location of the first expanded line. Errors go to diagnostics and the
+// offending definition or invocation is dropped, so reading goes on.
+class MacroReader {
+public:
+    static constexpr size_t MAX_DEPTH = 64;    // Nested invocations, guards against recursion
+
+    MacroReader(std::string_view text, MacroTable& macros, Diagnostics& diagnostics)
+        : reader(text), macros(macros), diagnostics(diagnostics) {}
+
+    bool next(SourceLine& tokens);              // Next line to assemble, false at the end
+    bool failed() const { return error_seen; }  // An error was reported
+    size_t linesRead() const { return lines_read; }
+
+private:
+    struct Frame {
+        const std::vector<SourceLine>* lines;
+        size_t next;
+    };
+
+    LineReader reader;
+    MacroTable& macros;
+    Diagnostics& diagnostics;
+    std::vector<Frame> stack;
+    size_t lines_read = 0;
+    bool error_seen = false;
+
+    void fail(std::string message, std::string_view at);
+};
+
+#endif // MACRO_H
@@ -0,0 +1,48 @@
+// Converts object programs between the text H/T/E format and the binary
+// .sicb format. The input format is detected from its contents; the output
+// format is the other one unless given with --to.
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "binary.h"
+#include "error.h"
+#include "source.h"
+
+int main(int argc, char** argv) {
+    std::string input, output, target;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--to" && i + 1 < argc)
+            target = argv[++i];
+        else if (input.empty())
+            input = arg;
+        else if (output.empty())
+            output = arg;
+    }
+    if (input.empty() || output.empty() || (!target.empty() && target != "text" && target != "binary")) {
+        std::cerr << "Usage: sic_objconv [--to text|binary] <input> <output>\n";
+        return 1;
+    }
+
+    SourceFile file;
+    if (!file.open(input)) {
+        error("Could not open file " + input);
+        return 1;
+    }
+    ObjectProgram program;
+    bool binaryInput = isBinaryObject(file.text());
+    if (!(binaryInput ? readBinaryObject(input, program) : readTextObject(file.text(), program)))
+        return 1;
+
+    bool toBinary = target.empty() ? !binaryInput : target == "binary";
+    if (toBinary)
+        return writeBinaryObject(output, program) ? 0 : 1;
+
+    std::ofstream out(output);
+    if (!out.is_open()) {
+        error("Could not create object file " + output);
+        return 1;
+    }
+    out << formatTextObject(program);
+    return out ? 0 : 1;
+}
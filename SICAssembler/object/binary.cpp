@@ -0,0 +1,308 @@
+#include "binary.h"
+#include <bit>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "error.h"
+#include "object.h"
+#include "source.h"
+
+static_assert(std::endian::native == std::endian::little, "the binary object format is mapped in place and assumes a little-endian host");
+
+namespace {
+
+constexpr char binary_magic[4] = {'S', 'I', 'C', 'B'};
+constexpr uint16_t binary_version = 1;
+
+bool parseHex(std::string_view text, int& value) {
+    auto [end, status] = std::from_chars(text.data(), text.data() + text.size(), value, 16);
+    return status == std::errc() && end == text.data() + text.size() && !text.empty();
+}
+
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+} // namespace
+
+void ObjectProgram::addBytes(int address, const unsigned char* bytes, size_t count) {
+    if (segments.empty() || segments.back().address + static_cast<int>(segments.back().bytes.size()) != address)
+        segments.push_back(ObjectSegment{address, {}});
+    segments.back().bytes.insert(segments.back().bytes.end(), bytes, bytes + count);
+}
+
+void ObjectProgram::flatten() {
+    // Already sorted segments with gaps between them are left alone
+    bool ordered = true;
+    for (size_t i = 1; ordered && i < segments.size(); i++)
+        ordered = segments[i].address > segments[i - 1].address + static_cast<int>(segments[i - 1].bytes.size());
+    if (ordered)
+        return;
+
+    int low = segments[0].address, high = low;
+    for (const ObjectSegment& segment : segments) {
+        low = std::min(low, segment.address);
+        high = std::max(high, segment.address + static_cast<int>(segment.bytes.size()));
+    }
+    std::vector<unsigned char> memory(high - low);
+    std::vector<bool> loaded(high - low);
+    for (const ObjectSegment& segment : segments) {
+        std::copy(segment.bytes.begin(), segment.bytes.end(), memory.begin() + (segment.address - low));
+        std::fill_n(loaded.begin() + (segment.address - low), segment.bytes.size(), true);
+    }
+    segments.clear();
+    for (int begin = 0, end; begin < high - low; begin = end) {
+        for (end = begin + 1; end < high - low && loaded[end] == loaded[begin]; end++) {}
+        if (loaded[begin])
+            addBytes(low + begin, memory.data() + begin, end - begin);
+    }
+}
+
+BinaryObjectView::~BinaryObjectView() {
+    if (data)
+        munmap(const_cast<unsigned char*>(data), length);
+}
+
+bool BinaryObjectView::open(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return error("Could not open object file " + filename);
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(BinaryHeader))) {
+        ::close(fd);
+        return error("Not a binary object file: " + filename);
+    }
+    length = static_cast<size_t>(info.st_size);
+    void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        length = 0;
+        return error("Could not map object file " + filename);
+    }
+    data = static_cast<const unsigned char*>(view);
+
+    // Validate once so segment() and bytes() can trust the offsets
+    const BinaryHeader& head = header();
+    bool valid = std::memcmp(head.magic, binary_magic, 4) == 0 && head.version == binary_version &&
+                 head.file_size == length && head.directory_offset % 4 == 0 &&
+                 head.directory_offset <= length &&
+                 (length - head.directory_offset) / sizeof(BinarySegment) >= head.segment_count;
+    for (uint32_t i = 0; valid && i < head.segment_count; i++) {
+        const BinarySegment& entry = segment(i);
+        valid = entry.offset <= head.directory_offset && entry.length <= head.directory_offset - entry.offset;
+    }
+    if (!valid)
+        return error("Corrupt binary object file " + filename);
+    return true;
+}
+
+const BinarySegment& BinaryObjectView::segment(size_t i) const {
+    return reinterpret_cast<const BinarySegment*>(data + header().directory_offset)[i];
+}
+
+bool isBinaryObject(std::string_view contents) {
+    return contents.size() >= 4 && std::memcmp(contents.data(), binary_magic, 4) == 0;
+}
+
+// Parse one H, T or E record into program; other records are left to the caller
+static bool readProgramRecord(std::string_view line, ObjectProgram& program, std::vector<unsigned char>& bytes) {
+    if (line[0] == 'H') {
+        // H <name, 6 columns> <start> <length>
+        if (line.size() < 22 || !parseHex(line.substr(9, 6), program.start_address) ||
+            !parseHex(line.substr(16, 6), program.program_length))
+            return error("Malformed header record: " + std::string(line));
+        std::string_view name = line.substr(2, 6);
+        while (!name.empty() && name.back() == ' ')
+            name.remove_suffix(1);
+        program.name = name;
+    } else if (line[0] == 'T') {
+        // T <address> <length> <hex object codes separated by spaces>
+        int address, count;
+        if (line.size() < 11 || !parseHex(line.substr(2, 6), address) || !parseHex(line.substr(9, 2), count))
+            return error("Malformed text record: " + std::string(line));
+        bytes.clear();
+        int high = -1;
+        for (char c : line.substr(11)) {
+            if (c == ' ')
+                continue;
+            int digit = hexDigit(c);
+            if (digit < 0)
+                return error("Malformed text record: " + std::string(line));
+            if (high < 0) {
+                high = digit;
+            } else {
+                bytes.push_back(static_cast<unsigned char>(high << 4 | digit));
+                high = -1;
+            }
+        }
+        if (high >= 0 || static_cast<int>(bytes.size()) != count)
+            return error("Text record length does not match its contents: " + std::string(line));
+        program.addBytes(address, bytes.data(), bytes.size());
+    } else if (line[0] == 'E') {
+        if (line.size() < 8 || !parseHex(line.substr(2, 6), program.entry_address))
+            return error("Malformed end record: " + std::string(line));
+    }
+    return true;
+}
+
+// Next whitespace separated field of a record
+static std::string_view nextField(std::string_view& line) {
+    size_t start = line.find_first_not_of(' ');
+    if (start == std::string_view::npos) {
+        line = std::string_view();
+        return line;
+    }
+    size_t end = std::min(line.find(' ', start), line.size());
+    std::string_view field = line.substr(start, end - start);
+    line.remove_prefix(end);
+    return field;
+}
+
+bool readTextObject(std::string_view text, ObjectProgram& program) {
+    LineReader reader(text);
+    std::string_view line;
+    std::vector<unsigned char> bytes;
+    while (reader.next(line)) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+            line.remove_suffix(1);
+        if (line.empty())
+            continue;
+        // Relocation and external symbols are the linker's job
+        if (line[0] == 'D' || line[0] == 'R' || line[0] == 'M')
+            return error("Unsupported linkage record, link the object with sic_link first: " + std::string(line));
+        if (!readProgramRecord(line, program, bytes))
+            return false;
+    }
+    // Records may come in any order and patch earlier ones
+    program.flatten();
+    return true;
+}
+
+bool readLinkableObject(std::string_view text, std::vector<ObjectSection>& sections) {
+    LineReader reader(text);
+    std::string_view line;
+    std::vector<unsigned char> bytes;
+    while (reader.next(line)) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+            line.remove_suffix(1);
+        if (line.empty())
+            continue;
+        if (line[0] == 'H')
+            sections.emplace_back();
+        if (sections.empty())
+            return error("Object record before the header: " + std::string(line));
+        ObjectSection& section = sections.back();
+
+        std::string_view fields = line.substr(1);
+        if (line[0] == 'D') {
+            // D <name> <address> ...
+            for (std::string_view name = nextField(fields); !name.empty(); name = nextField(fields)) {
+                int address;
+                if (!parseHex(nextField(fields), address))
+                    return error("Malformed definition record: " + std::string(line));
+                section.definitions.emplace_back(std::string(name), address);
+            }
+        } else if (line[0] == 'R') {
+            // R <name> ...
+            for (std::string_view name = nextField(fields); !name.empty(); name = nextField(fields))
+                section.references.emplace_back(name);
+        } else if (line[0] == 'M') {
+            // M <address> <length in hex digits> <+ or -><symbol>
+            ObjectModification modification;
+            std::string_view symbol;
+            if (!parseHex(nextField(fields), modification.address) || !parseHex(nextField(fields), modification.half_bytes) ||
+                (symbol = nextField(fields)).size() < 2 || (symbol[0] != '+' && symbol[0] != '-') ||
+                modification.half_bytes < 1 || modification.half_bytes > 6)
+                return error("Malformed modification record: " + std::string(line));
+            modification.negative = symbol[0] == '-';
+            modification.symbol = symbol.substr(1);
+            section.modifications.push_back(modification);
+        } else if (line[0] == 'E') {
+            section.has_entry = line.size() > 1;
+            if (section.has_entry && !readProgramRecord(line, section.program, bytes))
+                return false;
+        } else if (!readProgramRecord(line, section.program, bytes)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string formatTextObject(const ObjectProgram& program) {
+    ObjectWriter writer;
+    writer.header(program.name, program.start_address, program.program_length);
+    for (const ObjectSegment& segment : program.segments) {
+        for (size_t offset = 0; offset < segment.bytes.size(); offset += ObjectWriter::MAX_TEXT_RECORD_LENGTH) {
+            size_t count = std::min<size_t>(ObjectWriter::MAX_TEXT_RECORD_LENGTH, segment.bytes.size() - offset);
+            writer.startText(segment.address + static_cast<int>(offset));
+            writer.addText(segment.bytes.data() + offset, count);
+            writer.flushText();
+        }
+    }
+    writer.end(program.entry_address);
+    return writer.contents();
+}
+
+bool readBinaryObject(const std::string& filename, ObjectProgram& program) {
+    BinaryObjectView view;
+    if (!view.open(filename))
+        return false;
+    const BinaryHeader& head = view.header();
+    std::string_view name(head.name, sizeof(head.name));
+    while (!name.empty() && (name.back() == ' ' || name.back() == '\0'))
+        name.remove_suffix(1);
+    program.name = name;
+    program.start_address = static_cast<int>(head.start_address);
+    program.program_length = static_cast<int>(head.program_length);
+    program.entry_address = static_cast<int>(head.entry_address);
+    for (uint32_t i = 0; i < head.segment_count; i++) {
+        const BinarySegment& segment = view.segment(i);
+        program.addBytes(static_cast<int>(segment.address), view.bytes(segment), segment.length);
+    }
+    return true;
+}
+
+std::string formatBinaryObject(const ObjectProgram& program) {
+    BinaryHeader head{};
+    std::memcpy(head.magic, binary_magic, 4);
+    head.version = binary_version;
+    head.header_size = sizeof(BinaryHeader);
+    std::memset(head.name, ' ', sizeof(head.name));
+    std::memcpy(head.name, program.name.data(), std::min(program.name.size(), sizeof(head.name)));
+    head.start_address = static_cast<uint32_t>(program.start_address);
+    head.program_length = static_cast<uint32_t>(program.program_length);
+    head.entry_address = static_cast<uint32_t>(program.entry_address);
+    head.segment_count = static_cast<uint32_t>(program.segments.size());
+
+    std::string out(sizeof(BinaryHeader), '\0');
+    std::vector<BinarySegment> directory;
+    for (const ObjectSegment& segment : program.segments) {
+        directory.push_back(BinarySegment{static_cast<uint32_t>(segment.address),
+                                          static_cast<uint32_t>(segment.bytes.size()),
+                                          static_cast<uint32_t>(out.size())});
+        out.append(reinterpret_cast<const char*>(segment.bytes.data()), segment.bytes.size());
+        out.append((4 - out.size() % 4) % 4, '\0');
+    }
+    head.directory_offset = static_cast<uint32_t>(out.size());
+    out.append(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(BinarySegment));
+    head.file_size = static_cast<uint32_t>(out.size());
+    std::memcpy(out.data(), &head, sizeof(head));
+    return out;
+}
+
+bool writeBinaryObject(const std::string& filename, const ObjectProgram& program) {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open())
+        return error("Could not create object file " + filename);
+    std::string contents = formatBinaryObject(program);
+    out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    return static_cast<bool>(out) || error("Could not write object file " + filename);
+}
@@ -0,0 +1,107 @@
+#ifndef BINARY_H
+#define BINARY_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Loaded form of an object program, independent of its file format
+struct ObjectSegment {
+    int address;
+    std::vector<unsigned char> bytes;
+};
+
+struct ObjectProgram {
+    std::string name;
+    int start_address = 0;
+    int program_length = 0;
+    int entry_address = 0;
+    std::vector<ObjectSegment> segments;    // In address order of emission
+
+    // Append bytes, extending the last segment when they follow it directly
+    void addBytes(int address, const unsigned char* bytes, size_t count);
+    // Leave the segments as loading them in order leaves memory: sorted by
+    // address and merged, later bytes replacing earlier ones they overlap
+    void flatten();
+};
+
+// Binary object format (.sicb). All fields are little-endian and naturally
+// aligned so a mapped file can be used in place:
+//
+//   BinaryHeader
+//   segment data: raw bytes of each segment, padded to 4 bytes
+//   directory:    segment_count BinarySegment entries at directory_offset
+struct BinaryHeader {
+    char magic[4];                  // "SICB"
+    uint16_t version;
+    uint16_t header_size;
+    char name[8];                   // Program name, space padded
+    uint32_t start_address;
+    uint32_t program_length;
+    uint32_t entry_address;
+    uint32_t segment_count;
+    uint32_t directory_offset;
+    uint32_t file_size;
+};
+
+struct BinarySegment {
+    uint32_t address;
+    uint32_t length;
+    uint32_t offset;                // File offset of the segment's bytes
+};
+
+static_assert(sizeof(BinaryHeader) == 40, "BinaryHeader layout changed");
+static_assert(sizeof(BinarySegment) == 12, "BinarySegment layout changed");
+
+// Read-only mapping of a .sicb file; segments are used straight from the map
+class BinaryObjectView {
+public:
+    BinaryObjectView() = default;
+    ~BinaryObjectView();
+    BinaryObjectView(const BinaryObjectView&) = delete;
+    BinaryObjectView& operator=(const BinaryObjectView&) = delete;
+
+    bool open(const std::string& filename);
+    const BinaryHeader& header() const { return *reinterpret_cast<const BinaryHeader*>(data); }
+    const BinarySegment& segment(size_t i) const;
+    const unsigned char* bytes(const BinarySegment& segment) const { return data + segment.offset; }
+
+private:
+    const unsigned char* data = nullptr;
+    size_t length = 0;
+};
+
+// One control section of a linkable text object, with the records the
+// linker needs on top of H, T and E
+struct ObjectModification {
+    int address;
+    int half_bytes;                 // Length of the field in hex digits
+    bool negative;
+    std::string symbol;
+};
+
+struct ObjectSection {
+    ObjectProgram program;
+    bool has_entry = false;         // E record gave an entry address
+    std::vector<std::pair<std::string, int>> definitions;
+    std::vector<std::string> references;
+    std::vector<ObjectModification> modifications;
+};
+
+bool isBinaryObject(std::string_view contents);
+
+// Conversions between the text H/T/E format, the binary format and
+// ObjectProgram. readTextObject() rejects D, R and M records, which only
+// readLinkableObject() understands.
+bool readTextObject(std::string_view text, ObjectProgram& program);
+std::string formatTextObject(const ObjectProgram& program);
+bool readBinaryObject(const std::string& filename, ObjectProgram& program);
+std::string formatBinaryObject(const ObjectProgram& program);
+bool writeBinaryObject(const std::string& filename, const ObjectProgram& program);
+
+// Read every control section of a text object, D, R and M records included
+bool readLinkableObject(std::string_view text, std::vector<ObjectSection>& sections);
+
+#endif // BINARY_H
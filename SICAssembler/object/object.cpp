@@ -0,0 +1,229 @@
+#include "object.h"
+#include <array>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// Two hex digits for every byte value, so encoding is one lookup per byte
+constexpr std::array<char, 512> buildHexTable() {
+    const char digits[] = "0123456789ABCDEF";
+    std::array<char, 512> table{};
+    for (int i = 0; i < 256; i++) {
+        table[2 * i] = digits[i >> 4];
+        table[2 * i + 1] = digits[i & 0xF];
+    }
+    return table;
+}
+
+constexpr std::array<char, 512> hex_table = buildHexTable();
+
+} // namespace
+
+void appendHex(std::string& out, const unsigned char* bytes, size_t count) {
+    size_t offset = out.size();
+    out.resize(offset + 2 * count);
+    char* dest = out.data() + offset;
+    for (size_t i = 0; i < count; i++) {
+        std::memcpy(dest + 2 * i, &hex_table[2 * bytes[i]], 2);
+    }
+}
+
+void appendHex(std::string& out, unsigned value, int digits) {
+    static const char hex_digits[] = "0123456789ABCDEF";
+    size_t offset = out.size();
+    out.resize(offset + digits);
+    for (int i = digits - 1; i >= 0; i--) {
+        out[offset + i] = hex_digits[value & 0xF];
+        value >>= 4;
+    }
+}
+
+ObjectWriter::ObjectWriter() {
+    buffer.reserve(FLUSH_THRESHOLD + 128);
+    text_objects.reserve(3 * MAX_TEXT_RECORD_LENGTH);
+}
+
+ObjectWriter::~ObjectWriter() {
+    close();
+}
+
+bool ObjectWriter::open(const std::string& filename) {
+    close();
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    owned = true;
+    origin = 0;
+    written = 0;
+    failed = false;
+    discarding = false;
+    buffer.clear();
+    return fd >= 0;
+}
+
+bool ObjectWriter::attach(int descriptor) {
+    close();
+    fd = descriptor;
+    owned = false;
+    // Appending descriptors ignore the offset given to pwrite, so they cannot be patched
+    int flags = fcntl(fd, F_GETFL);
+    origin = flags < 0 || (flags & O_APPEND) ? -1 : lseek(fd, 0, SEEK_CUR);
+    written = 0;
+    failed = false;
+    discarding = false;
+    buffer.clear();
+    return flags >= 0;
+}
+
+bool ObjectWriter::close() {
+    if (fd < 0)
+        return true;
+    flushText();
+    flush();
+    bool ok = (!owned || ::close(fd) == 0) && !failed;
+    fd = -1;
+    return ok;
+}
+
+void ObjectWriter::discard() {
+    close();
+    discarding = true;
+    buffer.clear();
+}
+
+void ObjectWriter::flush() {
+    if (discarding)
+        buffer.clear();
+    if (fd < 0)
+        return;
+    const char* data = buffer.data();
+    size_t remaining = buffer.size();
+    while (remaining > 0) {
+        ssize_t count = ::write(fd, data, remaining);
+        if (count < 0) {
+            failed = true;
+            break;
+        }
+        data += count;
+        remaining -= static_cast<size_t>(count);
+        written += static_cast<size_t>(count);
+    }
+    buffer.clear();
+}
+
+void ObjectWriter::header(std::string_view name, int start, int length) {
+    // Program name is padded or truncated to exactly 6 characters
+    header_position = written + buffer.size();
+    buffer += "H ";
+    name = name.substr(0, 6);
+    buffer += name;
+    buffer.append(6 - name.size(), ' ');
+    buffer += ' ';
+    appendHex(buffer, start, 6);
+    buffer += ' ';
+    appendHex(buffer, length, 6);
+    buffer += '\n';
+}
+
+void ObjectWriter::end(int start) {
+    flushText();
+    buffer += "E ";
+    appendHex(buffer, start, 6);
+    buffer += '\n';
+    if (buffer.size() >= FLUSH_THRESHOLD)
+        flush();
+}
+
+void ObjectWriter::end() {
+    flushText();
+    buffer += "E\n";
+    if (buffer.size() >= FLUSH_THRESHOLD)
+        flush();
+}
+
+// Names in linkage records take 6 columns, like the program name
+static void appendName(std::string& out, std::string_view name) {
+    name = name.substr(0, 6);
+    out += name;
+    out.append(6 - name.size(), ' ');
+}
+
+void ObjectWriter::definitions(const std::vector<std::pair<std::string_view, int>>& names) {
+    // Six definitions per record
+    for (size_t i = 0; i < names.size(); i++) {
+        buffer += i % 6 == 0 ? "D" : "";
+        buffer += ' ';
+        appendName(buffer, names[i].first);
+        buffer += ' ';
+        appendHex(buffer, names[i].second, 6);
+        if (i % 6 == 5 || i + 1 == names.size())
+            buffer += '\n';
+    }
+}
+
+void ObjectWriter::references(const std::vector<std::string_view>& names) {
+    // Twelve references per record
+    for (size_t i = 0; i < names.size(); i++) {
+        bool last = i % 12 == 11 || i + 1 == names.size();
+        buffer += i % 12 == 0 ? "R" : "";
+        buffer += ' ';
+        if (last) {
+            buffer += names[i].substr(0, 6);
+            buffer += '\n';
+        } else {
+            appendName(buffer, names[i]);
+        }
+    }
+}
+
+void ObjectWriter::modification(int address, int halfBytes, std::string_view symbol) {
+    buffer += "M ";
+    appendHex(buffer, address, 6);
+    buffer += ' ';
+    appendHex(buffer, halfBytes, 2);
+    buffer += " +";
+    buffer += symbol;
+    buffer += '\n';
+    if (buffer.size() >= FLUSH_THRESHOLD)
+        flush();
+}
+
+bool ObjectWriter::patchHeaderLength(int length) {
+    flushText();
+    flush();
+    if (fd < 0 || origin < 0 || failed)
+        return false;
+    // The length follows "H ", the 6 character name, the start address and two spaces
+    std::string digits;
+    appendHex(digits, length, 6);
+    off_t position = origin + static_cast<off_t>(header_position + 16);
+    return pwrite(fd, digits.data(), digits.size(), position) == static_cast<ssize_t>(digits.size());
+}
+
+void ObjectWriter::startText(int address) {
+    text_address = address;
+}
+
+void ObjectWriter::addText(const unsigned char* bytes, size_t count) {
+    if (text_length > 0)
+        text_objects += ' ';
+    appendHex(text_objects, bytes, count);
+    text_length += static_cast<int>(count);
+}
+
+void ObjectWriter::flushText() {
+    if (text_length == 0)
+        return;
+    buffer += "T ";
+    appendHex(buffer, text_address, 6);
+    buffer += ' ';
+    appendHex(buffer, text_length, 2);
+    buffer += ' ';
+    buffer += text_objects;
+    buffer += '\n';
+    text_objects.clear();
+    text_length = 0;
+    text_records++;
+    if (buffer.size() >= FLUSH_THRESHOLD)
+        flush();
+}
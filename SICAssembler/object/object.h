@@ -0,0 +1,77 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <string>
+#include <sys/types.h>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Append the upper-case hex encoding of bytes to out, two characters per byte
+void appendHex(std::string& out, const unsigned char* bytes, size_t count);
+
+// Append value as exactly digits upper-case hex characters
+void appendHex(std::string& out, unsigned value, int digits);
+
+// Writes H/T/E object records into a reusable buffer. The buffer goes to the
+// file only when it fills up or on close(); without a file the records stay
+// in memory and can be read back with contents().
+class ObjectWriter {
+public:
+    static constexpr int MAX_TEXT_RECORD_LENGTH = 30; // Maximum bytes per text record (60 hex chars)
+
+    ObjectWriter();
+    ~ObjectWriter();
+    ObjectWriter(const ObjectWriter&) = delete;
+    ObjectWriter& operator=(const ObjectWriter&) = delete;
+
+    bool open(const std::string& filename);
+    bool attach(int descriptor);        // Write to an open descriptor that close() leaves open
+    bool close();                       // Flush everything and close the file
+    void discard();                     // Drop output instead of keeping it in memory
+
+    void header(std::string_view name, int start, int length);
+    void end(int start);
+    void end();                         // End record of a section without an entry point
+
+    // Linkage records of a control section: D lists the names it defines
+    // with their addresses, R the names it uses from other sections, and M
+    // asks the loader to add symbol to halfBytes hex digits at address
+    void definitions(const std::vector<std::pair<std::string_view, int>>& names);
+    void references(const std::vector<std::string_view>& names);
+    void modification(int address, int halfBytes, std::string_view symbol);
+    // Rewrite the length in the header already written. Only possible when
+    // the output is seekable; returns false otherwise.
+    bool patchHeaderLength(int length);
+
+    // Text records hold space separated object codes; each call to
+    // addText() adds one of them to the current record
+    void startText(int address);
+    void addText(const unsigned char* bytes, size_t count);
+    void flushText();                   // Write the current text record, if any
+    bool textEmpty() const { return text_length == 0; }
+    int textLength() const { return text_length; }
+    size_t textRecords() const { return text_records; }
+
+    const std::string& contents() const { return buffer; }
+
+private:
+    static constexpr size_t FLUSH_THRESHOLD = 1 << 16;
+
+    int fd = -1;
+    bool owned = true;                  // close() closes fd
+    off_t origin = -1;                  // File offset of the first byte written, -1 if not seekable
+    size_t written = 0;                 // Bytes written to fd so far
+    size_t header_position = 0;         // Offset of the header record from origin
+    bool failed = false;
+    bool discarding = false;
+    std::string buffer;                 // Pending output
+    std::string text_objects;           // Hex of the current text record
+    int text_address = 0;
+    int text_length = 0;
+    size_t text_records = 0;            // Text records written so far
+
+    void flush();
+};
+
+#endif // OBJECT_H
@@ -0,0 +1,149 @@
+#include "optab.h"
+#include "error.h"
+#include <array>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+
+// Generated from sic/opcode and sicxe/opcode by the Makefile
+#define OPCODE(mnemonic, value, format) {mnemonic, value, format},
+constexpr OpcodeEntry builtin_entries[] = {
+#include "opcode.inc"
+};
+constexpr OpcodeEntry builtin_xe_entries[] = {
+#include "opcode_xe.inc"
+};
+#undef OPCODE
+
+// Smallest power of two with at least four times as many slots as
+// mnemonics; with fewer, a perfect seed for the SIC/XE set is too rare
+constexpr size_t slotCount(size_t count) {
+    size_t slots = 8;
+    while (slots < 4 * count)
+        slots *= 2;
+    return slots;
+}
+
+template <size_t Count>
+struct BuiltinLayout {
+    std::array<unsigned short, slotCount(Count)> slots{};
+    unsigned seed = 0;
+    bool found = false;
+};
+
+template <size_t Count>
+constexpr BuiltinLayout<Count> buildLayout(const OpcodeEntry (&builtin)[Count]) {
+    BuiltinLayout<Count> layout;
+    std::array<OpcodeEntry, Count> entries{};
+    for (size_t i = 0; i < Count; i++)
+        entries[i] = builtin[i];
+    layout.found = findPerfectSeed(entries, layout.slots, layout.seed);
+    return layout;
+}
+
+constexpr auto builtin_layout = buildLayout(builtin_entries);
+static_assert(builtin_layout.found, "no perfect hash seed for sic/opcode");
+constexpr auto builtin_xe_layout = buildLayout(builtin_xe_entries);
+static_assert(builtin_xe_layout.found, "no perfect hash seed for sicxe/opcode");
+
+} // namespace
+
+Optab::Optab() : entries(nullptr), count(0), slots(nullptr), mask(0), seed(0) {}
+
+Optab::Optab(const OpcodeEntry* entries, size_t count, const unsigned short* slots, unsigned mask, unsigned seed)
+    : entries(entries), count(count), slots(slots), mask(mask), seed(seed) {}
+
+const Optab& Optab::builtin() {
+    static const Optab table(builtin_entries, std::size(builtin_entries), builtin_layout.slots.data(),
+                             static_cast<unsigned>(builtin_layout.slots.size()) - 1, builtin_layout.seed);
+    return table;
+}
+
+const Optab& Optab::builtinXE() {
+    static const Optab table(builtin_xe_entries, std::size(builtin_xe_entries), builtin_xe_layout.slots.data(),
+                             static_cast<unsigned>(builtin_xe_layout.slots.size()) - 1, builtin_xe_layout.seed);
+    return table;
+}
+
+int Optab::find(std::string_view mnemonic) const {
+    if (count == 0)
+        return -1;
+    int id = slots[optabHash(mnemonic, seed) & mask] - 1;
+    if (id < 0 || !equalsIgnoreCase(entries[id].mnemonic, mnemonic))
+        return -1;
+    return id;
+}
+
+bool Optab::load(const std::string& filename) {
+    std::ifstream infile(filename);
+    if (!infile.is_open()) {
+        return error("Unable to open file " + filename + " for reading.");
+    }
+
+    // Same layout as sic/opcode: a header line, then "<mnemonic> <hex value>",
+    // optionally followed by the format as in sicxe/opcode
+    std::string line;
+    if (!std::getline(infile, line)) {
+        return error("File is empty or couldn't read header.");
+    }
+    // Everything is built aside and only replaces the current table once the
+    // file has proved valid, so a failed load leaves the table usable
+    std::string loadedNames;
+    std::vector<std::pair<size_t, size_t>> spans;
+    std::vector<unsigned char> values, formats;
+    // A repeated mnemonic has no perfect hash layout, so it is caught here
+    // rather than after every seed has been tried
+    std::unordered_map<std::string, int> firstLine;
+    int number = 1;
+    while (std::getline(infile, line)) {
+        number++;
+        std::istringstream iss(line);
+        std::string mnemonic, value;
+        int format = 3;
+        if (!(iss >> mnemonic >> value))
+            continue;
+        unsigned opcode = 0;
+        auto [end, status] = std::from_chars(value.data(), value.data() + value.size(), opcode, 16);
+        if (status != std::errc() || end != value.data() + value.size() || opcode > 0xFF)
+            return error(filename + ":" + std::to_string(number) + ": invalid opcode value " + value);
+        if (!(iss >> format) || format < 1 || format > 3)
+            format = 3;
+        for (char& c : mnemonic)
+            c = upperChar(c);
+        auto [first, added] = firstLine.emplace(mnemonic, number);
+        if (!added)
+            return error(filename + ":" + std::to_string(number) + ": " + mnemonic + " repeats the mnemonic of line " +
+                         std::to_string(first->second));
+        spans.emplace_back(loadedNames.size(), mnemonic.size());
+        loadedNames += mnemonic;
+        values.push_back(static_cast<unsigned char>(opcode));
+        formats.push_back(static_cast<unsigned char>(format));
+    }
+
+    // Views are taken only once the names have stopped growing, and again
+    // after they moved into the table
+    auto entriesOf = [&](const std::string& storage) {
+        std::vector<OpcodeEntry> list;
+        for (size_t i = 0; i < spans.size(); i++)
+            list.push_back(OpcodeEntry{std::string_view(storage).substr(spans[i].first, spans[i].second), values[i], formats[i]});
+        return list;
+    };
+    std::vector<unsigned short> loadedSlots(slotCount(spans.size()), 0);
+    unsigned loadedSeed;
+    if (!findPerfectSeed(entriesOf(loadedNames), loadedSlots, loadedSeed)) {
+        return error("No perfect hash layout for " + filename);
+    }
+
+    names = std::move(loadedNames);
+    owned_entries = entriesOf(names);
+    owned_slots = std::move(loadedSlots);
+    seed = loadedSeed;
+    entries = owned_entries.data();
+    count = owned_entries.size();
+    slots = owned_slots.data();
+    mask = static_cast<unsigned>(owned_slots.size()) - 1;
+    return true;
+}
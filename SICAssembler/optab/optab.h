@@ -0,0 +1,95 @@
+#ifndef OPTAB_H
+#define OPTAB_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct OpcodeEntry {
+    std::string_view mnemonic;  // Upper-case mnemonic
+    unsigned char value;        // Opcode byte
+    unsigned char format;       // Instruction format: 1, 2 or 3 (3 also covers SIC/XE format 4)
+};
+
+constexpr char upperChar(char c) {
+    return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+constexpr bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (upperChar(a[i]) != upperChar(b[i]))
+            return false;
+    }
+    return true;
+}
+
+// Seeded FNV-1a over the upper-cased mnemonic
+constexpr unsigned optabHash(std::string_view mnemonic, unsigned seed) {
+    unsigned hash = 2166136261u ^ seed;
+    for (char c : mnemonic) {
+        hash ^= static_cast<unsigned char>(upperChar(c));
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+// Search for a seed under which every mnemonic lands in its own slot. slots
+// receives entry index + 1 per slot (0 = empty). Usable at compile time for
+// the built-in table and at run time for override files.
+template <typename Entries, typename Slots>
+constexpr bool findPerfectSeed(const Entries& entries, Slots& slots, unsigned& seed) {
+    const unsigned mask = static_cast<unsigned>(slots.size()) - 1;
+    for (seed = 0; seed < 100000; seed++) {
+        for (auto& slot : slots)
+            slot = 0;
+        bool collision = false;
+        for (size_t i = 0; i < entries.size() && !collision; i++) {
+            auto& slot = slots[optabHash(entries[i].mnemonic, seed) & mask];
+            collision = slot != 0;
+            slot = static_cast<unsigned short>(i + 1);
+        }
+        if (!collision)
+            return true;
+    }
+    return false;
+}
+
+// Operation code table. The built-in instances are generated at build time
+// from sic/opcode and sicxe/opcode into a perfect-hash layout, so lookups are
+// case-insensitive, allocation-free and need no file at run time. load()
+// builds the same layout from an override file for experimental instruction
+// sets.
+class Optab {
+public:
+    Optab();                                        // Empty table, fill with load()
+    Optab(const Optab&) = delete;
+    Optab& operator=(const Optab&) = delete;
+
+    static const Optab& builtin();
+    static const Optab& builtinXE();                // SIC/XE instructions, formats 1 to 3
+    bool load(const std::string& filename);
+
+    int find(std::string_view mnemonic) const;     // Opcode id or -1
+    int value(int id) const { return entries[id].value; }
+    int format(int id) const { return entries[id].format; }
+    std::string_view mnemonic(int id) const { return entries[id].mnemonic; }
+    int size() const { return static_cast<int>(count); }
+
+private:
+    Optab(const OpcodeEntry* entries, size_t count, const unsigned short* slots, unsigned mask, unsigned seed);
+
+    const OpcodeEntry* entries;
+    size_t count;
+    const unsigned short* slots;
+    unsigned mask;
+    unsigned seed;
+
+    // Storage for tables built by load()
+    std::string names;
+    std::vector<OpcodeEntry> owned_entries;
+    std::vector<unsigned short> owned_slots;
+};
+
+#endif // OPTAB_H
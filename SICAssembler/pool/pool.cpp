@@ -0,0 +1,85 @@
+#include "pool.h"
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0)
+        threads = 1;
+    for (unsigned i = 0; i < threads; i++)
+        queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back(&ThreadPool::run, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    // Spread submissions round-robin; idle workers steal to even out the load
+    unsigned index = next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    {
+        std::lock_guard<std::mutex> guard(queues[index]->lock);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        queued++;
+        pending++;
+    }
+    work_ready.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> guard(state_lock);
+    all_done.wait(guard, [this] { return pending == 0; });
+}
+
+bool ThreadPool::take(unsigned self, std::function<void()>& task) {
+    {
+        Queue& own = *queues[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        Queue& victim = *queues[(self + offset) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(unsigned self) {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(state_lock);
+            work_ready.wait(guard, [this] { return stopping || queued > 0; });
+            if (queued == 0)
+                return; // Stopping with nothing left to do
+            queued--;
+        }
+
+        // A task is reserved for us, but another worker may have dequeued it
+        // first; keep looking until one turns up
+        std::function<void()> task;
+        while (!take(self, task))
+            std::this_thread::yield();
+        task();
+
+        std::lock_guard<std::mutex> guard(state_lock);
+        if (--pending == 0)
+            all_done.notify_all();
+    }
+}
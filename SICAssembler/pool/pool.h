@@ -0,0 +1,46 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every worker owns a deque: it pops its own work
+// from the back and, once empty, steals from the front of the others.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    void wait();                        // Block until every submitted task has run
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<unsigned> next_queue{0};
+    std::mutex state_lock;
+    std::condition_variable work_ready;
+    std::condition_variable all_done;
+    size_t queued = 0;                  // Tasks waiting in any queue
+    size_t pending = 0;                 // Tasks submitted but not finished
+    bool stopping = false;
+
+    bool take(unsigned self, std::function<void()>& task);
+    void run(unsigned self);
+};
+
+#endif // POOL_H
@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "serve.h"
+#include "error.h"
+#include "pool.h"
+#include "SICXEasm.h"
+
+// A message is a list of sections, each "<name> <length>\n" followed by
+// length bytes, closed by an "end 0\n" section.
+//
+//   request:  format (text, binary or both), machine (sic or sicxe),
+//             dumps (text, snapshot or none), xref (yes or no), source
+//   response: status (ok or failed), object, binary, symbols, blocks,
+//             snapshot, xref, diagnostics
+
+namespace {
+
+constexpr size_t MAX_SECTION_LENGTH = size_t(1) << 28;
+// How long a worker waits on a client that stops sending or reading
+constexpr timeval CLIENT_TIMEOUT{10, 0};
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool sendSection(int fd, std::string_view name, std::string_view payload) {
+    std::string header = std::string(name) + " " + std::to_string(payload.size()) + "\n";
+    return writeAll(fd, header.data(), header.size()) && writeAll(fd, payload.data(), payload.size());
+}
+
+// Buffered reads from a socket
+class SocketReader {
+public:
+    explicit SocketReader(int fd) : fd(fd) {}
+
+    bool readLine(std::string& line) {
+        line.clear();
+        char c;
+        while (readBytes(&c, 1)) {
+            if (c == '\n')
+                return true;
+            line += c;
+            if (line.size() > 64)
+                return false;
+        }
+        return false;
+    }
+
+    bool readBytes(char* out, size_t size) {
+        while (size > 0) {
+            if (start == end && !fill())
+                return false;
+            size_t count = std::min(size, end - start);
+            std::memcpy(out, buffer + start, count);
+            start += count;
+            out += count;
+            size -= count;
+        }
+        return true;
+    }
+
+private:
+    int fd;
+    char buffer[1 << 16];
+    size_t start = 0, end = 0;
+
+    bool fill() {
+        ssize_t count;
+        do {
+            count = ::read(fd, buffer, sizeof(buffer));
+        } while (count < 0 && errno == EINTR);
+        if (count <= 0)
+            return false;
+        start = 0;
+        end = static_cast<size_t>(count);
+        return true;
+    }
+};
+
+bool receive(int fd, std::map<std::string, std::string>& sections) {
+    SocketReader reader(fd);
+    std::string header;
+    while (reader.readLine(header)) {
+        size_t space = header.find(' ');
+        if (space == std::string::npos)
+            return false;
+        std::string name = header.substr(0, space);
+        size_t length = std::strtoull(header.c_str() + space + 1, nullptr, 10);
+        if (name == "end")
+            return true;
+        if (length > MAX_SECTION_LENGTH)
+            return false;
+        std::string& payload = sections[name];
+        payload.resize(length);
+        if (!reader.readBytes(payload.data(), length))
+            return false;
+    }
+    return false;
+}
+
+sockaddr_un socketAddress(const std::string& socketPath) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    return address;
+}
+
+const char* formatName(ObjectFormat format) {
+    switch (format) {
+        case ObjectFormat::BINARY: return "binary";
+        case ObjectFormat::BOTH:   return "both";
+        default:                   return "text";
+    }
+}
+
+const char* dumpsName(DumpFormat dumps) {
+    switch (dumps) {
+        case DumpFormat::SNAPSHOT: return "snapshot";
+        case DumpFormat::NONE:     return "none";
+        default:                   return "text";
+    }
+}
+
+void handleClient(int client, const Optab& optab, const AssemblerOptions& options) {
+    // Every worker keeps one assembler, so its tables stay allocated
+    thread_local std::unique_ptr<Assembler> sic = makeAssembler(optab, options);
+
+    std::map<std::string, std::string> request;
+    if (!receive(client, request))
+        return;
+    AssemblerOptions requestOptions = options;
+    requestOptions.threads = 1;     // Concurrency comes from serving many clients
+    const std::string& format = request["format"];
+    if (format == "binary") requestOptions.object_format = ObjectFormat::BINARY;
+    else if (format == "both") requestOptions.object_format = ObjectFormat::BOTH;
+    else requestOptions.object_format = ObjectFormat::TEXT;
+    const std::string& dumps = request["dumps"];
+    if (dumps == "snapshot") requestOptions.dumps = DumpFormat::SNAPSHOT;
+    else if (dumps == "none") requestOptions.dumps = DumpFormat::NONE;
+    else requestOptions.dumps = DumpFormat::TEXT;
+    requestOptions.cross_reference = request["xref"] == "yes";
+    sic->options() = requestOptions;
+
+    // The opcode table was chosen for the server's machine
+    const char* machine = options.machine == Machine::SICXE ? "sicxe" : "sic";
+    AssemblyResult result;
+    if (request["machine"] != machine) {
+        result.diagnostics.push_back(std::string("The server assembles for ") + machine + " only");
+    } else {
+        try {
+            result = sic->assembleBuffer(request["source"]);
+        } catch (const std::exception& e) {
+            result.ok = false;
+            result.diagnostics.push_back(e.what());
+        }
+    }
+    std::string diagnostics;
+    for (const std::string& message : result.diagnostics)
+        diagnostics += message + "\n";
+
+    const std::pair<const char*, std::string_view> response[] = {
+        {"status", result.ok ? "ok" : "failed"}, {"object", result.object}, {"binary", result.binary},
+        {"symbols", result.symbol_dump}, {"blocks", result.block_dump}, {"snapshot", result.snapshot},
+        {"xref", result.cross_reference}, {"diagnostics", diagnostics}, {"end", ""},
+    };
+    for (const auto& [name, payload] : response) {
+        if (!sendSection(client, name, payload))
+            return;
+    }
+}
+
+// Turn a "line:column: error: message" line the server sent back into a
+// diagnostic; false for messages that are not about the source
+bool parseDiagnostic(std::string_view text, Diagnostic& diagnostic) {
+    diagnostic = Diagnostic{Severity::ERROR, 0, 0, {}};
+    for (int* number : {&diagnostic.line, &diagnostic.column}) {
+        auto [end, status] = std::from_chars(text.data(), text.data() + text.size(), *number);
+        if (status != std::errc())
+            break;
+        text.remove_prefix(end - text.data());
+        if (text.starts_with(": ")) {
+            text.remove_prefix(2);
+            break;
+        }
+        if (!text.starts_with(':'))
+            return false;
+        text.remove_prefix(1);
+    }
+    if (text.starts_with("warning: ")) {
+        diagnostic.severity = Severity::WARNING;
+        text.remove_prefix(9);
+    } else if (text.starts_with("error: ")) {
+        text.remove_prefix(7);
+    } else {
+        return false;
+    }
+    diagnostic.message = text;
+    return true;
+}
+
+bool writeOutput(const std::string& filename, const std::string& contents) {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open())
+        return error("Could not create " + filename);
+    out << contents;
+    return out.good() || error("Could not write " + filename);
+}
+
+} // namespace
+
+bool serve(const std::string& socketPath, const Optab& optab, const AssemblerOptions& options, unsigned jobs) {
+    // A client that hangs up must not take the server down
+    std::signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un address = socketAddress(socketPath);
+    if (socketPath.size() >= sizeof(address.sun_path))
+        return error("Socket path too long: " + socketPath);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        return error("Could not create socket");
+    unlink(socketPath.c_str()); // Left behind by a server that was killed
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listener, SOMAXCONN) < 0) {
+        close(listener);
+        return error("Could not listen on " + socketPath + ": " + std::strerror(errno));
+    }
+
+    ThreadPool pool(jobs);
+    for (;;) {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            error(std::string("Could not accept connection: ") + std::strerror(errno));
+            break;
+        }
+        // An idle client gives its worker back instead of holding it
+        if (setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &CLIENT_TIMEOUT, sizeof(CLIENT_TIMEOUT)) < 0 ||
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &CLIENT_TIMEOUT, sizeof(CLIENT_TIMEOUT)) < 0) {
+            close(client);
+            continue;
+        }
+        pool.submit([client, &optab, &options] {
+            handleClient(client, optab, options);
+            close(client);
+        });
+    }
+    pool.wait();
+    close(listener);
+    return false;
+}
+
+bool assembleRemote(const std::string& socketPath, const std::string& filename,
+                    const AssemblerOptions& options, bool& ok) {
+    sockaddr_un address = socketAddress(socketPath);
+    if (socketPath.size() >= sizeof(address.sun_path))
+        return false;
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0)
+        return false;
+    if (connect(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        close(server);
+        return false;
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+    SourceFile source;
+    if (!source.open(filename)) {
+        close(server);
+        ok = error("Could not open file " + filename);
+        return true;
+    }
+    std::map<std::string, std::string> response;
+    bool sent = sendSection(server, "format", formatName(options.object_format)) &&
+                sendSection(server, "machine", options.machine == Machine::SICXE ? "sicxe" : "sic") &&
+                sendSection(server, "dumps", dumpsName(options.dumps)) &&
+                sendSection(server, "xref", options.cross_reference ? "yes" : "no") &&
+                sendSection(server, "source", source.text()) &&
+                sendSection(server, "end", "");
+    bool received = sent && receive(server, response);
+    close(server);
+    if (!received) {
+        ok = error("Lost connection to server " + socketPath);
+        return true;
+    }
+
+    // Same files and messages as Assembler::assemble, in the caller's
+    // diagnostic format. Source diagnostics come back without a file name
+    Diagnostics diagnostics;
+    diagnostics.begin(filename, {});
+    Diagnostic diagnostic;
+    std::string line;
+    for (std::istringstream messages(response["diagnostics"]); std::getline(messages, line);) {
+        if (parseDiagnostic(line, diagnostic))
+            diagnostics.add(std::move(diagnostic));
+        else
+            error(line);
+    }
+    if (!diagnostics.all().empty() || options.diagnostic_format == DiagnosticFormat::JSON) {
+        std::ostream* stream = errorStream();
+        diagnostics.write(stream ? *stream : std::cerr, options.diagnostic_format);
+    }
+    std::string baseName = std::filesystem::path(filename).replace_extension().string();
+    ok = response["status"] == "ok";
+    if (options.dumps == DumpFormat::TEXT) {
+        ok = writeOutput(baseName + ".symbol.dump", response["symbols"]) && ok;
+        ok = writeOutput(baseName + ".block.dump", response["blocks"]) && ok;
+    } else if (options.dumps == DumpFormat::SNAPSHOT) {
+        ok = writeOutput(baseName + ".snapshot", response["snapshot"]) && ok;
+    }
+    if (response["status"] != "ok") {
+        // An object file left from an earlier run must not pass for this one
+        std::error_code ignored;
+        std::filesystem::remove(baseName + ".obj", ignored);
+        std::filesystem::remove(baseName + ".sicb", ignored);
+    } else {
+        if (options.object_format != ObjectFormat::BINARY)
+            ok = writeOutput(baseName + ".obj", response["object"]) && ok;
+        if (options.object_format != ObjectFormat::TEXT)
+            ok = writeOutput(baseName + ".sicb", response["binary"]) && ok;
+    }
+    if (options.cross_reference && !response["xref"].empty())
+        ok = writeOutput(baseName + ".xref", response["xref"]) && ok;
+    return true;
+}
@@ -0,0 +1,21 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <string>
+#include "Assembler.h"
+
+// Listen on a Unix domain socket and assemble the sources clients send. The
+// opcode table and the worker threads (each with its own assembler) stay
+// warm between requests; every connection carries one request. Runs until
+// the process is stopped, returns false if the socket cannot be set up.
+bool serve(const std::string& socketPath, const Optab& optab, const AssemblerOptions& options, unsigned jobs);
+
+// Have the server at socketPath assemble filename, then write the outputs
+// and print the diagnostics, in options.diagnostic_format, as a local run
+// would. Only the output options travel with the source. Returns false if
+// no server answered, so the caller can assemble locally; ok tells whether
+// it assembled.
+bool assembleRemote(const std::string& socketPath, const std::string& filename,
+                    const AssemblerOptions& options, bool& ok);
+
+#endif // SERVE_H
@@ -3,183 +3,202 @@
 #include <iomanip>
 #include <cctype>     
 #include <sstream>     
-#include <stdexcept>  
 #include <functional> 
+#include <charconv>
 #include "SICasm.h"
 
 
-int SIC_assembler::addressTranslation(const std::string& opcode, const std::string& line) {
-    // Convert opcode to uppercase for case-insensitive comparison
-    std::string upperOpcode = opcode;
-    std::transform(upperOpcode.begin(), upperOpcode.end(), upperOpcode.begin(), ::toupper);
-    
-    // Get the operand portion of the instruction
-    std::string operand;
-    std::istringstream iss(line);
-    std::string temp;
-    iss >> temp; // Skip the opcode
-    iss >> operand; // Get the operand
+// Report a malformed line through problem; -1 tells the caller it failed
+static int fail(std::string& problem, std::string message) {
+    problem = std::move(message);
+    return -1;
+}
+
+// Parse a decimal operand without copying it
+static bool parseInt(std::string_view text, int& value) {
+    auto [end, status] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return status == std::errc() && end != text.data();
+}
+
+// Value of a hex digit, -1 if c is not one
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+int SIC_assembler::addressTranslation(const SourceLine& line, const LineRecord& record, std::string& problem) {
+    std::string_view operand = line.operand;
     
-    if (upperOpcode == "WORD") {
+    if (record.directive == Directive::WORD) {
         // WORD directive - always 3 bytes
+        int value;
+        if (!parseInt(operand, value)) {
+            return fail(problem, "WORD operand must be a valid integer");
+        }
         return 3;
     } 
-    else if (upperOpcode == "BYTE") {
+    else if (record.directive == Directive::BYTE) {
         // BYTE directive - length depends on the operand
         if (operand.empty()) {
-            throw std::runtime_error("BYTE directive requires an operand");
+            return fail(problem, "BYTE directive requires an operand");
         }
         
         if (operand[0] == 'C' || operand[0] == 'c') {
             // Character constant
             if (operand.length() < 3 || operand[1] != '\'' || operand[operand.length()-1] != '\'') {
-                throw std::runtime_error("Invalid format for character constant in BYTE directive");
+                return fail(problem, "Invalid format for character constant in BYTE directive");
             }
-            // Extract the string between the quotes
-            std::string charConstant = operand.substr(2, operand.length() - 3);
-            return charConstant.length();
+            // Length of the string between the quotes
+            return operand.length() - 3;
         } 
         else if (operand[0] == 'X' || operand[0] == 'x') {
             // Hexadecimal constant
             if (operand.length() < 3 || operand[1] != '\'' || operand[operand.length()-1] != '\'') {
-                throw std::runtime_error("Invalid format for hex constant in BYTE directive");
+                return fail(problem, "Invalid format for hex constant in BYTE directive");
+            }
+            for (char c : operand.substr(2, operand.length() - 3)) {
+                if (hexDigit(c) < 0) {
+                    return fail(problem, "Invalid hex constant in BYTE directive: " + std::string(operand));
+                }
             }
-            // Extract the hex string between the quotes
-            std::string hexConstant = operand.substr(2, operand.length() - 3);
             // Each pair of hex digits represents one byte
-            return (hexConstant.length() + 1) / 2; // Ceiling division
+            return (operand.length() - 3 + 1) / 2; // Ceiling division
         } 
         else {
-            throw std::runtime_error("BYTE directive requires 'C' or 'X' type specifier");
+            return fail(problem, "BYTE directive requires 'C' or 'X' type specifier");
         }
     } 
-    else if (upperOpcode == "RESW") {
+    else if (record.directive == Directive::RESW) {
         // RESW directive - 3 bytes per word reserved
         if (operand.empty()) {
-            throw std::runtime_error("RESW directive requires an operand");
+            return fail(problem, "RESW directive requires an operand");
         }
         
-        try {
-            int value = std::stoi(operand);
-            if (value < 0) {
-                throw std::runtime_error("RESW operand must be non-negative");
-            }
-            return 3 * value;
-        } catch (const std::invalid_argument&) {
-            throw std::runtime_error("RESW operand must be a valid integer");
+        int value;
+        if (!parseInt(operand, value)) {
+            return fail(problem, "RESW operand must be a valid integer");
+        }
+        if (value < 0) {
+            return fail(problem, "RESW operand must be non-negative");
         }
+        return 3 * value;
     } 
-    else if (upperOpcode == "RESB") {
+    else if (record.directive == Directive::RESB) {
         // RESB directive - reserves specified number of bytes
         if (operand.empty()) {
-            throw std::runtime_error("RESB directive requires an operand");
+            return fail(problem, "RESB directive requires an operand");
         }
         
-        try {
-            int value = std::stoi(operand);
-            if (value < 0) {
-                throw std::runtime_error("RESB operand must be non-negative");
-            }
-            return value;
-        } catch (const std::invalid_argument&) {
-            throw std::runtime_error("RESB operand must be a valid integer");
+        int value;
+        if (!parseInt(operand, value)) {
+            return fail(problem, "RESB operand must be a valid integer");
         }
+        if (value < 0) {
+            return fail(problem, "RESB operand must be non-negative");
+        }
+        return value;
     } 
+    else if (record.directive == Directive::BASE || record.directive == Directive::NOBASE) {
+        return fail(problem, std::string(line.operation) + " requires SIC/XE");
+    }
     else {
-        // Check if the opcode is valid by looking it up in optab
-        if (optab.value(upperOpcode, "value").empty()) 
-            throw std::runtime_error("Invalid opcode: " + opcode);
+        // Pass1 already looked the opcode up in optab
+        if (record.opcode < 0) 
+            return fail(problem, "Invalid opcode: " + std::string(line.operation));
+        if (record.format != 3 || record.prefix != 0)
+            return fail(problem, "SIC/XE syntax is not valid for SIC: " + std::string(line.operation) + " " + std::string(operand));
         return 3; // Standard instruction - 3 bytes
     }
 }
 
-std::tuple<std::string, int, bool> SIC_assembler::generateObjectCode(const std::string& opcode, const std::string& operand, std::string opcodeValue, std::string operandAddress) {
-    std::string objectCode = "";
+std::tuple<int, bool> SIC_assembler::generateObjectCode(const LineRecord& record, int operandAddress, std::vector<unsigned char>& objectCode,
+                                                        std::string& problem) {
     int objectCodeLength = 0;
     bool isReserveDirective = false;
+    std::string_view operand = record.operand;
     
-    if (opcodeValue.empty()) {
+    if (record.directive != Directive::NONE) {
         // Handle directives like BYTE, WORD, RESB, RESW
-        if (opcode == "BYTE") {
-            if (operand[0] == 'C') {
-                // Convert character constant to hex
-                for (size_t i = 2; i < operand.length() - 1; i++) {
-                    char c = operand[i];
-                    std::stringstream ss;
-                    ss << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << static_cast<int>(c);
-                    objectCode += ss.str();
+        if (record.directive == Directive::BYTE) {
+            std::string_view constant = operand.substr(2, operand.length() - 3);
+            if (operand[0] == 'C' || operand[0] == 'c') {
+                // Character constant: the characters are the bytes
+                objectCode.insert(objectCode.end(), constant.begin(), constant.end());
+            } else if (operand[0] == 'X' || operand[0] == 'x') {
+                // Hex constant: an odd digit count gets a leading zero, as pass1 sized it
+                bool highNibble = constant.length() % 2 == 0;
+                unsigned char byte = 0;
+                for (char c : constant) {
+                    int digit = hexDigit(c);
+                    if (digit < 0) {
+                        return std::make_tuple(fail(problem, "Invalid hex constant in BYTE directive: " + std::string(operand)), false);
+                    }
+                    if (highNibble) {
+                        byte = static_cast<unsigned char>(digit << 4);
+                    } else {
+                        objectCode.push_back(static_cast<unsigned char>(byte | digit));
+                    }
+                    highNibble = !highNibble;
                 }
-            } else if (operand[0] == 'X') {
-                // Extract hex constant
-                objectCode = operand.substr(2, operand.length() - 3);
             }
             
-            objectCodeLength = objectCode.length() / 2;
+            objectCodeLength = objectCode.size();
         } 
-        else if (opcode == "WORD") {
-            // Convert decimal to 6-digit hex
-            int value = std::stoi(operand);
-            std::stringstream ss;
-            ss << std::hex << std::uppercase << std::setw(6) << std::setfill('0') << value;
-            objectCode = ss.str();
+        else if (record.directive == Directive::WORD) {
+            // Convert decimal to a 3-byte word
+            int value;
+            if (!parseInt(operand, value)) {
+                return std::make_tuple(fail(problem, "WORD operand must be a valid integer"), false);
+            }
+            objectCode.push_back(static_cast<unsigned char>(value >> 16));
+            objectCode.push_back(static_cast<unsigned char>(value >> 8));
+            objectCode.push_back(static_cast<unsigned char>(value));
             objectCodeLength = 3; // WORD = 3 bytes
         } 
-        else if ( opcode == "RESW") {
+        else if (record.directive == Directive::RESW) {
             // Reserve bytes/words - marked for ending the current text record
-            int value = std::stoi(operand);
+            int value = 0;
+            parseInt(operand, value);
             objectCodeLength = 3 * value;
             isReserveDirective = true;
         }
-        else if ( opcode == "RESB" ) {
-            int value = std::stoi(operand);
+        else if (record.directive == Directive::RESB) {
+            int value = 0;
+            parseInt(operand, value);
             objectCodeLength = value;
             isReserveDirective = true;
         }
     } 
-    else {
-        // Regular instruction with opcode and operand
-        objectCode = opcodeValue;
+    else if (record.opcode >= 0) {
+        // Regular instruction: opcode byte followed by a 2-byte address
+        int address = 0; // No operand, pad with zeros
         
-        if (!operand.empty()) {
-            // Check if it's indexed addressing mode (operand ends with ,X)
-            bool isIndexed = false;
-            std::string actualOperand = operand;
-            
-            // Check for ,X at the end of the operand
-            size_t commaPos = operand.find(",X");
-            if (commaPos != std::string::npos) {
-                isIndexed = true;
-                actualOperand = operand.substr(0, commaPos); // Remove ,X from operand
+        if (record.symbol != SymbolTable::npos || record.literal >= 0) {
+            if (operandAddress == SymbolTable::undefined) {
+                return std::make_tuple(fail(problem, "Undefined symbol: " + std::string(operand)), false);
             }
-            
-            if (operandAddress.empty()) {
-                throw std::runtime_error("Undefined symbol: " + operand);
+            // The top bit of the address field is the index flag
+            if (operandAddress < 0 || operandAddress > 0x7FFF) {
+                std::ostringstream message;
+                message << "Address " << std::hex << std::uppercase << operandAddress << " of " << operand.substr(0, operand.find(','))
+                        << " does not fit in 15 bits";
+                return std::make_tuple(fail(problem, message.str()), false);
             }
-            
+
             // For indexed addressing, add 8000(hex) to the address
-            if (isIndexed) {
-                // Convert hex string to integer
-                int addr = std::stoi(operandAddress, nullptr, 16);
-                // Add 8000 hex (32768 decimal)
-                addr |= 0x8000;
-                // Convert back to hex string
-                std::stringstream ss;
-                ss << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << addr;
-                operandAddress = ss.str();
+            address = operandAddress;
+            if (record.indexed) {
+                address |= 0x8000;
             }
-            
-            // Combine opcode and operand address
-            objectCode += operandAddress;
         } 
-        else {
-            // No operand, pad with zeros
-            objectCode += "0000";
-        }
         
-        objectCodeLength = objectCode.length() / 2;
+        objectCode.push_back(static_cast<unsigned char>(record.opcode));
+        objectCode.push_back(static_cast<unsigned char>(address >> 8));
+        objectCode.push_back(static_cast<unsigned char>(address));
+        objectCodeLength = 3;
     }
     
-    return std::make_tuple(objectCode, objectCodeLength, isReserveDirective);
+    return std::make_tuple(objectCodeLength, isReserveDirective);
 }
-
-
@@ -7,12 +7,13 @@
 
 class SIC_assembler : public Assembler {
     public:
-        SIC_assembler(const std::string& opcode_file)
-            : Assembler(opcode_file) {}
+        SIC_assembler(const Optab& optab = Optab::builtin())
+            : Assembler(optab) {}
 
     protected: 
-        int addressTranslation(const std::string& opcode, const std::string& line) override; 
-        std::tuple<std::string, int, bool> generateObjectCode(const std::string& opcode, const std::string& operand, std::string opcodeValue, std::string operandAddress) override;
+        int addressTranslation(const SourceLine& line, const LineRecord& record, std::string& problem) override;
+        std::tuple<int, bool> generateObjectCode(const LineRecord& record, int operandAddress, std::vector<unsigned char>& objectCode,
+                                                 std::string& problem) override;
 };
 
 #endif // SIC_ASSEMBLER_H
@@ -0,0 +1,419 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include "SICXEasm.h"
+
+// Report a malformed line through problem; -1 tells the caller it failed
+static int fail(std::string& problem, std::string message) {
+    problem = std::move(message);
+    return -1;
+}
+
+static bool parseInt(std::string_view text, int& value) {
+    auto [end, status] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return status == std::errc() && end == text.data() + text.size();
+}
+
+// Flag bits of format 3 and 4 instructions, after the n and i bits
+constexpr int X_BIT = 0x8;
+constexpr int B_BIT = 0x4;
+constexpr int P_BIT = 0x2;
+constexpr int E_BIT = 0x1;
+
+// n and i bits of the first byte, by operand prefix
+static int addressingBits(char prefix) {
+    return prefix == '#' ? 1 : prefix == '@' ? 2 : 3;
+}
+
+// Register numbers for format 2 operands
+constexpr struct {
+    std::string_view name;
+    int number;
+} registers[] = {
+    {"A", 0}, {"X", 1}, {"L", 2}, {"B", 3}, {"S", 4}, {"T", 5}, {"F", 6}, {"PC", 8}, {"SW", 9},
+};
+
+// What an operand field of a format 2 instruction holds
+enum class Field : unsigned char { NONE, REGISTER, NUMBER, COUNT };
+
+// Format 2 instructions whose operands are not two registers, by opcode
+constexpr struct {
+    unsigned char opcode;
+    Field r1, r2;
+} format2_operands[] = {
+    {0xB4, Field::REGISTER, Field::NONE},   // CLEAR r1
+    {0xB8, Field::REGISTER, Field::NONE},   // TIXR r1
+    {0xB0, Field::NUMBER, Field::NONE},     // SVC n
+    {0xA4, Field::REGISTER, Field::COUNT},  // SHIFTL r1,n
+    {0xA8, Field::REGISTER, Field::COUNT},  // SHIFTR r1,n
+};
+
+// One operand field of a format 2 instruction as a half-byte, -1 if malformed
+static int format2Field(std::string_view text, Field field) {
+    if (field == Field::REGISTER) {
+        for (const auto& entry : registers) {
+            if (equalsIgnoreCase(text, entry.name))
+                return entry.number;
+        }
+        return -1;
+    }
+    int value;
+    if (!parseInt(text, value))
+        return -1;
+    if (field == Field::COUNT)
+        value--;    // Shift counts 1 to 16 are stored as 0 to 15
+    return value >= 0 && value <= 15 ? value : -1;
+}
+
+// Second byte of a format 2 instruction, -1 if its operand is malformed
+static int format2Operands(int opcode, std::string_view operand) {
+    Field first = Field::REGISTER, second = Field::REGISTER;
+    for (const auto& entry : format2_operands) {
+        if (entry.opcode == opcode) {
+            first = entry.r1;
+            second = entry.r2;
+        }
+    }
+    size_t comma = operand.find(',');
+    if ((second == Field::NONE) != (comma == std::string_view::npos))
+        return -1;
+    int high = format2Field(operand.substr(0, comma), first);
+    int low = second == Field::NONE ? 0 : format2Field(operand.substr(comma + 1), second);
+    if (high < 0 || low < 0)
+        return -1;
+    return high << 4 | low;
+}
+
+// An immediate operand that is a number rather than a symbol (#3), as
+// pass1 decoded it
+static bool immediateConstant(const LineRecord& record, std::string_view operand, int& value, bool& valid) {
+    if (record.prefix != '#' || operand.size() < 2 || !(std::isdigit(static_cast<unsigned char>(operand[1])) || operand[1] == '-'))
+        return false;
+    valid = parseInt(operand.substr(1), value) && value >= 0 && value <= 0xFFFFF;
+    return true;
+}
+
+// How a format 3 instruction ending at pc reaches target: its b and p flags
+// and 12-bit displacement, or false if only format 4 can. PC-relative comes
+// first, then base-relative, then a direct address below 4096, which only
+// absolute programs can use. relax() and the encoder both decide here, so
+// they always agree.
+static bool displacement(int target, int pc, int base, bool direct, int& flags, int& disp) {
+    if (target - pc >= -2048 && target - pc <= 2047) {
+        flags = P_BIT;
+        disp = target - pc;
+    } else if (base >= 0 && target - base >= 0 && target - base <= 4095) {
+        flags = B_BIT;
+        disp = target - base;
+    } else if (direct && target >= 0 && target <= 4095) {
+        flags = 0;
+        disp = target;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int SICXE_assembler::addressTranslation(const SourceLine& line, const LineRecord& record, std::string& problem) {
+    std::string_view operand = line.operand;
+    if (record.directive == Directive::BASE)
+        return operand.empty() ? fail(problem, "BASE directive requires an operand") : 0;
+    if (record.directive == Directive::NOBASE)
+        return 0;
+    if (record.directive != Directive::NONE || record.opcode < 0)
+        return SIC_assembler::addressTranslation(line, record, problem);
+
+    std::string operation(line.operation);
+    switch (record.format) {
+        case 0:
+            return fail(problem, "Only format 3 instructions have a format 4: " + operation);
+        case 1:
+            return operand.empty() ? 1 : fail(problem, operation + " takes no operand");
+        case 2:
+            if (format2Operands(record.opcode, operand) < 0)
+                return fail(problem, "Invalid register operand for " + operation + ": " + std::string(operand));
+            return 2;
+    }
+    if (record.indexed && record.prefix != 0)
+        return fail(problem, "Indexed addressing cannot be immediate or indirect: " + std::string(operand));
+    if (record.prefix != 0 && operand.size() < 2)
+        return fail(problem, "Missing operand after " + std::string(operand));
+    int value;
+    bool valid;
+    if (immediateConstant(record, operand, value, valid)) {
+        if (!valid)
+            return fail(problem, "Immediate value must be an integer from 0 to 1048575: " + std::string(operand));
+        return record.format == 4 || value > 4095 ? 4 : 3;
+    }
+    return record.format;   // Format 3 until relax() finds it must grow
+}
+
+std::tuple<int, bool> SICXE_assembler::generateObjectCode(const LineRecord& record, int operandAddress, std::vector<unsigned char>& objectCode,
+                                                          std::string& problem) {
+    std::string_view operand = record.operand;
+    if (record.directive == Directive::BASE) {
+        if (operandAddress == SymbolTable::undefined)
+            return std::make_tuple(fail(problem, "Undefined symbol: " + std::string(operand)), false);
+        return std::make_tuple(0, false);
+    }
+    if (record.directive != Directive::NONE || record.opcode < 0)
+        return SIC_assembler::generateObjectCode(record, operandAddress, objectCode, problem);
+
+    if (record.format == 1) {
+        objectCode.push_back(static_cast<unsigned char>(record.opcode));
+        return std::make_tuple(1, false);
+    }
+    if (record.format == 2) {
+        int registerByte = format2Operands(record.opcode, operand);
+        if (registerByte < 0)
+            return std::make_tuple(fail(problem, "Invalid register operand: " + std::string(operand)), false);
+        objectCode.push_back(static_cast<unsigned char>(record.opcode));
+        objectCode.push_back(static_cast<unsigned char>(registerByte));
+        return std::make_tuple(2, false);
+    }
+
+    // Formats 3 and 4: opcode with n and i, then x, b, p and e, then the
+    // 12-bit displacement or 20-bit address
+    int format = record.format;
+    int flags = record.indexed ? X_BIT : 0;
+    int field = 0;      // No operand (RSUB) leaves it 0
+    int value;
+    bool valid;
+    if (immediateConstant(record, operand, value, valid)) {
+        if (!valid)
+            return std::make_tuple(fail(problem, "Invalid immediate value: " + std::string(operand)), false);
+        format = value > 4095 ? 4 : format;
+        field = value;
+    } else if (record.symbol != SymbolTable::npos || record.literal >= 0) {
+        if (operandAddress == SymbolTable::undefined)
+            return std::make_tuple(fail(problem, "Undefined symbol: " + std::string(operand)), false);
+        int bp, disp;
+        if (format == 4) {
+            field = operandAddress;
+        } else if (displacement(operandAddress, record.location + 3, record.base, !linkable, bp, disp)) {
+            flags |= bp;
+            field = disp;
+        } else {
+            return std::make_tuple(fail(problem, "Displacement out of range: " + std::string(operand)), false);
+        }
+    }
+
+    objectCode.push_back(static_cast<unsigned char>(record.opcode | addressingBits(record.prefix)));
+    if (format == 4) {
+        flags |= E_BIT;
+        objectCode.push_back(static_cast<unsigned char>(flags << 4 | ((field >> 16) & 0xF)));
+        objectCode.push_back(static_cast<unsigned char>(field >> 8));
+        objectCode.push_back(static_cast<unsigned char>(field));
+        return std::make_tuple(4, false);
+    }
+    objectCode.push_back(static_cast<unsigned char>(flags << 4 | ((field >> 8) & 0xF)));
+    objectCode.push_back(static_cast<unsigned char>(field));
+    return std::make_tuple(3, false);
+}
+
+bool SICXE_assembler::operandAffectsLayout(std::string_view) const {
+    // An immediate value or the distance to a symbol can pick format 4
+    return true;
+}
+
+std::pair<int, int> SICXE_assembler::addressField(const LineRecord& record) const {
+    // Only format 4 holds an address; format 3 displacements are relative
+    if (record.format == 4)
+        return {1, 5};
+    return {0, 0};
+}
+
+void SICXE_assembler::relax() {
+    // Every format 3 instruction with a symbol or literal operand starts in
+    // format 3. A round works out where everything is with the growth so
+    // far and moves each instruction whose target is out of reach to
+    // format 4. Growing only pushes lines further apart, so no instruction
+    // ever shrinks back, and rounds stop when one grows nothing. A round is
+    // linear in the number of such instructions, and programs settle in a
+    // few. Locations count within a block, or within a section for control
+    // sections, so growth is summed per group: the block or the section.
+    struct Place {
+        int group = -1;     // -1: nowhere, for a missing base
+        int rank = 0;       // Candidates of the group placed before it
+        int location = 0;   // Before relaxation
+        int block = 0;
+        int symbol = SymbolTable::npos;  // The label placed there, if any
+    };
+    struct Candidate {
+        size_t index;       // In program
+        Place at, target, base;
+        bool grown;
+    };
+
+    int groups = linkable ? static_cast<int>(sections.size()) : blocks.size();
+    auto symbolPlace = [&](int id) {
+        return Place{linkable ? symtab.section(id) : symtab.block(id), 0, symtab.address(id), symtab.block(id), id};
+    };
+    std::vector<Candidate> candidates;
+    std::vector<int> literalGroup(literals.size(), -1);
+    int section = 0, baseSymbol = SymbolTable::npos;
+    for (size_t i = 0; i < program.size(); i++) {
+        const LineRecord& record = program[i];
+        if (record.directive == Directive::CSECT) {
+            section++;
+            baseSymbol = SymbolTable::npos;
+        } else if (record.directive == Directive::BASE) {
+            baseSymbol = record.symbol;
+        } else if (record.directive == Directive::NOBASE) {
+            baseSymbol = SymbolTable::npos;
+        }
+        int group = linkable ? section : record.block;
+        if (record.directive != Directive::NONE || record.opcode < 0)
+            continue;
+        if (record.literal >= 0)
+            literalGroup[record.literal] = group;
+        if (record.format != 3)
+            continue;
+
+        Candidate candidate{i, {group, 0, record.location, record.block}, {}, {}, false};
+        if (record.literal >= 0 && literals.location(record.literal) >= 0) {
+            int block = literals.block(record.literal);
+            candidate.target = {linkable ? group : block, 0, literals.location(record.literal), block};
+        } else if (record.symbol != SymbolTable::npos && symtab.external(record.symbol)) {
+            candidate.grown = true;     // Only the linker knows the address
+        } else if (record.symbol != SymbolTable::npos && symtab.defined(record.symbol)) {
+            candidate.target = symbolPlace(record.symbol);
+        } else {
+            continue;   // Constants, no operand, or an undefined symbol pass2 reports
+        }
+        if (baseSymbol != SymbolTable::npos && symtab.defined(baseSymbol) && !symtab.external(baseSymbol))
+            candidate.base = symbolPlace(baseSymbol);
+        candidates.push_back(candidate);
+    }
+
+    // Order the candidates by group; within one, program order is location order
+    std::vector<int> begin(groups + 1, 0);
+    for (const Candidate& candidate : candidates)
+        begin[candidate.at.group + 1]++;
+    for (int g = 0; g < groups; g++)
+        begin[g + 1] += begin[g];
+    std::vector<int> order(candidates.size()), locations(candidates.size());
+    std::vector<int> next(begin.begin(), begin.end() - 1);
+    for (size_t k = 0; k < candidates.size(); k++) {
+        Candidate& candidate = candidates[k];
+        int position = next[candidate.at.group]++;
+        order[position] = static_cast<int>(k);
+        locations[position] = candidate.at.location;
+        candidate.at.rank = position - begin[candidate.at.group];
+    }
+    auto rankOf = [&](int group, int location) {
+        auto first = locations.begin() + begin[group];
+        return static_cast<int>(std::lower_bound(first, locations.begin() + begin[group + 1], location) - first);
+    };
+    // Rank every label once, in id order: labels are defined in program
+    // order, so the searches walk each group's locations mostly forwards
+    std::vector<int> symbolRank(symtab.size(), 0);
+    for (int id = 0; id < symtab.size(); id++) {
+        if (symtab.defined(id) && !symtab.external(id)) {
+            Place place = symbolPlace(id);
+            symbolRank[id] = rankOf(place.group, place.location);
+        }
+    }
+    auto rank = [&](Place& place) {
+        if (place.group >= 0)
+            place.rank = place.symbol != SymbolTable::npos ? symbolRank[place.symbol] : rankOf(place.group, place.location);
+    };
+    for (Candidate& candidate : candidates) {
+        rank(candidate.target);
+        rank(candidate.base);
+    }
+
+    // grownBefore[p]: candidates grown among the first p in group order
+    std::vector<int> grownBefore(candidates.size() + 1, 0), offset(blocks.size(), 0);
+    auto growth = [&](int group, int rank) {
+        return grownBefore[begin[group] + rank] - grownBefore[begin[group]];
+    };
+    auto address = [&](const Place& place) {
+        return place.location + growth(place.group, place.rank) + offset[place.block];
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        stats.relax_rounds++;
+        for (size_t p = 0; p < order.size(); p++)
+            grownBefore[p + 1] = grownBefore[p] + (candidates[order[p]].grown ? 1 : 0);
+        // Blocks follow each other, so each one moves by what the ones before it grew
+        if (!linkable) {
+            int start = 0;
+            for (int b = 0; b < blocks.size(); b++) {
+                offset[b] = start;
+                start += blocks.location(b) - start_address + growth(b, begin[b + 1] - begin[b]);
+            }
+        }
+        int flags, disp;
+        for (Candidate& candidate : candidates) {
+            if (candidate.grown)
+                continue;
+            int base = candidate.base.group < 0 ? -1 : address(candidate.base);
+            if (!displacement(address(candidate.target), address(candidate.at) + 3, base, !linkable, flags, disp)) {
+                candidate.grown = true;
+                changed = true;
+            }
+        }
+    }
+
+    // Move every line, label, literal and block by the growth before it
+    std::vector<int> moved(groups, 0);
+    size_t k = 0;
+    section = 0;
+    for (size_t i = 0; i < program.size(); i++) {
+        LineRecord& record = program[i];
+        if (record.directive == Directive::CSECT)
+            section++;
+        int group = linkable ? section : record.block;
+        record.location += moved[group];
+        if (k == candidates.size() || candidates[k].index != i)
+            continue;
+        const Candidate& candidate = candidates[k++];
+        if (candidate.grown) {
+            record.format = 4;
+            moved[group]++;
+            stats.long_formats++;
+        } else if (candidate.base.group >= 0) {
+            record.base = address(candidate.base);
+        }
+    }
+    for (int id = 0; id < symtab.size(); id++) {
+        if (!symtab.defined(id) || symtab.external(id))
+            continue;
+        int group = linkable ? symtab.section(id) : symtab.block(id);
+        symtab.define(id, symtab.address(id) + growth(group, symbolRank[id]), symtab.block(id));
+    }
+    for (int id = 0; id < static_cast<int>(literals.size()); id++) {
+        int group = linkable ? literalGroup[id] : literals.block(id);
+        if (literals.location(id) >= 0 && group >= 0)
+            literals.place(id, literals.location(id) + growth(group, rankOf(group, literals.location(id))), literals.block(id));
+    }
+
+    int total = 0;
+    for (int g = 0; g < groups; g++) {
+        int grown = growth(g, begin[g + 1] - begin[g]);
+        total += grown;
+        if (linkable)
+            sections[g].length += grown;
+        else
+            blocks.location(g) += grown;
+    }
+    if (linkable)
+        blocks.location(0) += moved[groups - 1];
+    else if (!sections.empty())
+        sections[0].length += total;
+    program_length += total;
+    if (!program.empty() && program.back().directive == Directive::END)
+        blocks.finish(start_address);
+}
+
+std::unique_ptr<Assembler> makeAssembler(const Optab& optab, const AssemblerOptions& options) {
+    std::unique_ptr<Assembler> assembler;
+    if (options.machine == Machine::SICXE)
+        assembler = std::make_unique<SICXE_assembler>(optab);
+    else
+        assembler = std::make_unique<SIC_assembler>(optab);
+    assembler->options() = options;
+    return assembler;
+}
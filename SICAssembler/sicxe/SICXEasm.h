@@ -0,0 +1,32 @@
+#ifndef SICXE_ASSEMBLER_H
+#define SICXE_ASSEMBLER_H
+
+#include "SICasm.h"
+#include <memory>
+#include <string>
+
+// SIC/XE: formats 1 and 2, and format 3 instructions with immediate (#),
+// indirect (@) and indexed operands reached PC- or base-relative. An
+// instruction is assembled in format 3 wherever its displacement fits and
+// in format 4 otherwise; +operation always asks for format 4. Which fits
+// depends on where the other lines end up, so relax() decides after pass1.
+// Directives are assembled as on SIC.
+class SICXE_assembler : public SIC_assembler {
+    public:
+        SICXE_assembler(const Optab& optab = Optab::builtinXE())
+            : SIC_assembler(optab) {}
+
+    protected:
+        int addressTranslation(const SourceLine& line, const LineRecord& record, std::string& problem) override;
+        std::tuple<int, bool> generateObjectCode(const LineRecord& record, int operandAddress, std::vector<unsigned char>& objectCode,
+                                                 std::string& problem) override;
+        bool operandAffectsLayout(std::string_view operation) const override;
+        std::pair<int, int> addressField(const LineRecord& record) const override;
+        bool sizesAreLocal() const override { return false; }
+        void relax() override;
+};
+
+// The assembler for options.machine, with those options set
+std::unique_ptr<Assembler> makeAssembler(const Optab& optab, const AssemblerOptions& options);
+
+#endif // SICXE_ASSEMBLER_H
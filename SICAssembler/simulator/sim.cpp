@@ -0,0 +1,100 @@
+// Runs an assembled object program (.obj or .sicb) on the SIC simulator. A
+// .asm source is assembled straight into memory first (load-and-go).
+// Devices read and write files: --device F1=input.txt, or by default the
+// file named after the device number (F1, 05) in the working directory.
+#include <charconv>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "binary.h"
+#include "error.h"
+#include "optab.h"
+#include "SICasm.h"
+#include "simulator.h"
+#include "source.h"
+
+// Parse all of text as a number; false on anything else
+template <typename T>
+static bool parseNumber(std::string_view text, T& value, int base = 10) {
+    auto [end, status] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+    return status == std::errc() && end != text.data() && end == text.data() + text.size();
+}
+
+int main(int argc, char** argv) {
+    std::string input, opcodeFile;
+    uint64_t maxSteps = 0;
+    bool quiet = false;
+    std::vector<std::pair<int, std::string>> devices;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--device" && i + 1 < argc) {
+            std::string device = argv[++i];
+            size_t equals = device.find('=');
+            int number = 0;
+            if (equals == 0 || equals == std::string::npos || equals > 2 ||
+                !parseNumber(std::string_view(device).substr(0, equals), number, 16)) {
+                std::cerr << "Invalid device " << device << ", expected XX=file\n";
+                return 1;
+            }
+            devices.emplace_back(number, device.substr(equals + 1));
+        } else if (arg == "--optab" && i + 1 < argc) {
+            opcodeFile = argv[++i];      // Same opcode table the program was assembled with
+        } else if (arg == "--max-steps" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], maxSteps)) {
+                std::cerr << "Invalid step count " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--quiet") {
+            quiet = true;                // No report on stderr
+        } else {
+            input = arg;
+        }
+    }
+    if (input.empty()) {
+        std::cerr << "Usage: sic_sim [--device XX=file] [--optab file] [--max-steps n] [--quiet] <object file or .asm source>\n";
+        return 1;
+    }
+
+    Optab customOptab;
+    if (!opcodeFile.empty() && !customOptab.load(opcodeFile))
+        return 1;
+    const Optab& optab = opcodeFile.empty() ? Optab::builtin() : customOptab;
+
+    SourceFile file;
+    if (!file.open(input)) {
+        error("Could not open file " + input);
+        return 1;
+    }
+    ObjectProgram program;
+    bool loaded;
+    if (input.ends_with(".asm")) {
+        SIC_assembler sic(optab);
+        loaded = sic.assembleImage(file.text(), program, input);
+    } else {
+        loaded = isBinaryObject(file.text()) ? readBinaryObject(input, program) : readTextObject(file.text(), program);
+    }
+    Simulator simulator(optab);
+    if (!loaded || !simulator.load(program))
+        return 1;
+    for (const auto& [device, filename] : devices)
+        simulator.attach(device, filename);
+
+    auto started = std::chrono::steady_clock::now();
+    bool ok = simulator.run(maxSteps);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    if (!quiet) {
+        std::cerr << std::fixed << std::setprecision(3)
+                  << "Executed " << simulator.steps() << " instructions in " << seconds * 1000 << " ms ("
+                  << std::setprecision(0) << (seconds > 0 ? simulator.steps() / seconds : 0) << " instructions/s)\n"
+                  << std::uppercase << std::hex << std::setfill('0')
+                  << "A=" << std::setw(6) << simulator.a() << " X=" << std::setw(6) << simulator.x()
+                  << " L=" << std::setw(6) << simulator.l() << " PC=" << std::setw(6) << simulator.pc() << std::endl;
+    }
+    if (ok && maxSteps && simulator.steps() == maxSteps) {
+        error("Stopped after " + std::to_string(maxSteps) + " instructions");
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
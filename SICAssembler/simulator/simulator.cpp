@@ -0,0 +1,295 @@
+#include <cstdio>
+#include "simulator.h"
+#include "error.h"
+
+// GCC and Clang dispatch through a table of label addresses, so every handler
+// ends in its own indirect jump; other compilers fall back to a switch.
+// Define SIM_SWITCH_DISPATCH to force the switch, e.g. to compare the two.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(SIM_SWITCH_DISPATCH)
+#define SIM_COMPUTED_GOTO 1
+#endif
+
+namespace {
+
+constexpr int WORD_MASK = 0xFFFFFF;
+
+// Condition code values kept in SW
+constexpr int CC_LT = 0x40;
+constexpr int CC_EQ = 0x00;
+constexpr int CC_GT = 0x80;
+
+struct Binding {
+    const char* mnemonic;
+    Simulator::Handler handler;
+};
+
+const Binding bindings[] = {
+    {"LDA", Simulator::LDA},   {"LDX", Simulator::LDX},   {"LDL", Simulator::LDL},
+    {"LDCH", Simulator::LDCH}, {"STA", Simulator::STA},   {"STX", Simulator::STX},
+    {"STL", Simulator::STL},   {"STCH", Simulator::STCH}, {"STSW", Simulator::STSW},
+    {"ADD", Simulator::ADD},   {"SUB", Simulator::SUB},   {"MUL", Simulator::MUL},
+    {"DIV", Simulator::DIV},   {"AND", Simulator::AND},   {"OR", Simulator::OR},
+    {"COMP", Simulator::COMP}, {"TIX", Simulator::TIX},   {"J", Simulator::J},
+    {"JEQ", Simulator::JEQ},   {"JGT", Simulator::JGT},   {"JLT", Simulator::JLT},
+    {"JSUB", Simulator::JSUB}, {"RSUB", Simulator::RSUB}, {"TD", Simulator::TD},
+    {"RD", Simulator::RD},     {"WD", Simulator::WD},
+};
+
+std::string hex(int value, int digits) {
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "%0*X", digits, value);
+    return buffer;
+}
+
+int signExtend(int word) {
+    return (word ^ 0x800000) - 0x800000;
+}
+
+int compare(int left, int right) {
+    left = signExtend(left);
+    right = signExtend(right);
+    return left < right ? CC_LT : left == right ? CC_EQ : CC_GT;
+}
+
+int readWord(const unsigned char* bytes) {
+    return bytes[0] << 16 | bytes[1] << 8 | bytes[2];
+}
+
+void writeWord(unsigned char* bytes, int word) {
+    bytes[0] = static_cast<unsigned char>(word >> 16);
+    bytes[1] = static_cast<unsigned char>(word >> 8);
+    bytes[2] = static_cast<unsigned char>(word);
+}
+
+} // namespace
+
+Simulator::Simulator(const Optab& optab) : mem(MEMORY_SIZE), decoded(MEMORY_SIZE) {
+    for (const Binding& binding : bindings) {
+        int id = optab.find(binding.mnemonic);
+        if (id >= 0)
+            handlers[optab.value(id)] = binding.handler;
+    }
+    for (int address = 0; address < MEMORY_SIZE; address++)
+        decode(address);
+}
+
+Simulator::~Simulator() {
+    for (Device& device : devices) {
+        if (device.file)
+            std::fclose(device.file);
+    }
+}
+
+bool Simulator::load(const ObjectProgram& program) {
+    if (program.start_address < 0 || program.start_address + program.program_length > MEMORY_SIZE)
+        return error("Program " + program.name + " does not fit in memory");
+    std::fill(mem.begin(), mem.end(), 0);
+    // Segments are copied in file order, so later text records win
+    for (const ObjectSegment& segment : program.segments) {
+        if (segment.address < 0 || segment.address + static_cast<int>(segment.bytes.size()) > MEMORY_SIZE)
+            return error("Text record at " + hex(segment.address, 6) + " outside memory");
+        std::copy(segment.bytes.begin(), segment.bytes.end(), mem.begin() + segment.address);
+    }
+    for (int address = 0; address < MEMORY_SIZE; address++)
+        decode(address);
+    reg_a = reg_x = reg_sw = 0;
+    reg_l = HALT_ADDRESS;
+    reg_pc = program.entry_address;
+    executed = 0;
+    return true;
+}
+
+void Simulator::attach(int device, const std::string& filename) {
+    devices[device & 0xFF].filename = filename;
+}
+
+void Simulator::decode(int address) {
+    Decoded& instruction = decoded[address];
+    if (address > MEMORY_SIZE - 3) {
+        instruction = {ILLEGAL, 0, 0};
+        return;
+    }
+    const unsigned char* bytes = &mem[address];
+    instruction.handler = handlers[bytes[0]];
+    instruction.indexed = bytes[1] >> 7;
+    instruction.address = static_cast<uint16_t>((bytes[1] & 0x7F) << 8 | bytes[2]);
+}
+
+// A store to [address, address + count) changes every instruction that
+// starts up to two bytes earlier
+void Simulator::redecode(int address, int count) {
+    int first = address >= 2 ? address - 2 : 0;
+    for (int i = first; i < address + count; i++)
+        decode(i);
+}
+
+FILE* Simulator::device(int id, bool writing) {
+    Device& device = devices[id];
+    if (device.file) {
+        if (device.writing != writing) {
+            error("Device " + hex(id, 2) + " is used for both input and output");
+            return nullptr;
+        }
+        return device.file;
+    }
+    if (device.filename.empty())
+        device.filename = hex(id, 2);
+    device.file = std::fopen(device.filename.c_str(), writing ? "wb" : "rb");
+    device.writing = writing;
+    if (!device.file)
+        error("Could not open device " + hex(id, 2) + " file " + device.filename);
+    return device.file;
+}
+
+#if SIM_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+bool Simulator::run(uint64_t maxSteps) {
+    const uint64_t limit = maxSteps ? executed + maxSteps : UINT64_MAX;
+    unsigned char* m = mem.data();
+    const Decoded* code = decoded.data();
+    int a = reg_a, x = reg_x, l = reg_l, pc = reg_pc, sw = reg_sw;
+    uint64_t count = executed;
+    Decoded instruction{};
+    int ea = 0;
+    bool ok = true;
+
+#if SIM_COMPUTED_GOTO
+    static void* const labels[HANDLER_COUNT] = {
+        &&do_ILLEGAL, &&do_LDA, &&do_LDX, &&do_LDL, &&do_LDCH, &&do_STA, &&do_STX, &&do_STL, &&do_STCH,
+        &&do_STSW, &&do_ADD, &&do_SUB, &&do_MUL, &&do_DIV, &&do_AND, &&do_OR, &&do_COMP, &&do_TIX,
+        &&do_J, &&do_JEQ, &&do_JGT, &&do_JLT, &&do_JSUB, &&do_RSUB, &&do_TD, &&do_RD, &&do_WD,
+    };
+#define DISPATCH() goto *labels[instruction.handler]
+#define HANDLER(name) do_##name:
+#else
+#define DISPATCH() goto dispatch
+#define HANDLER(name) case name:
+#endif
+
+    // Fetch the pre-decoded instruction at pc and jump to its handler
+#define NEXT()                                                          \
+    do {                                                                \
+        if (static_cast<unsigned>(pc) > MEMORY_SIZE - 3 || count == limit) \
+            goto stop;                                                  \
+        instruction = code[pc];                                         \
+        pc += 3;                                                        \
+        count++;                                                        \
+        ea = instruction.address + (instruction.indexed ? x : 0);       \
+        DISPATCH();                                                     \
+    } while (0)
+
+#define FAIL(message)                                                   \
+    do {                                                                \
+        pc -= 3;                                                        \
+        ok = error(std::string(message) + " at " + hex(pc, 6));         \
+        goto stop;                                                      \
+    } while (0)
+
+#define CHECK_WORD()  if (ea > MEMORY_SIZE - 3) FAIL("Address " + hex(ea, 6) + " out of memory")
+#define CHECK_BYTE()  if (ea >= MEMORY_SIZE) FAIL("Address " + hex(ea, 6) + " out of memory")
+
+    NEXT();
+
+#if !SIM_COMPUTED_GOTO
+dispatch:
+    switch (instruction.handler) {
+#endif
+    HANDLER(ILLEGAL) {
+        FAIL("Illegal instruction " + hex(m[pc - 3], 2));
+    }
+    HANDLER(LDA) { CHECK_WORD(); a = readWord(m + ea); NEXT(); }
+    HANDLER(LDX) { CHECK_WORD(); x = readWord(m + ea); NEXT(); }
+    HANDLER(LDL) { CHECK_WORD(); l = readWord(m + ea); NEXT(); }
+    HANDLER(LDCH) { CHECK_BYTE(); a = (a & 0xFFFF00) | m[ea]; NEXT(); }
+    HANDLER(STA) { CHECK_WORD(); writeWord(m + ea, a); redecode(ea, 3); NEXT(); }
+    HANDLER(STX) { CHECK_WORD(); writeWord(m + ea, x); redecode(ea, 3); NEXT(); }
+    HANDLER(STL) { CHECK_WORD(); writeWord(m + ea, l); redecode(ea, 3); NEXT(); }
+    HANDLER(STCH) { CHECK_BYTE(); m[ea] = static_cast<unsigned char>(a); redecode(ea, 1); NEXT(); }
+    HANDLER(STSW) { CHECK_WORD(); writeWord(m + ea, sw); redecode(ea, 3); NEXT(); }
+    HANDLER(ADD) { CHECK_WORD(); a = (a + readWord(m + ea)) & WORD_MASK; NEXT(); }
+    HANDLER(SUB) { CHECK_WORD(); a = (a - readWord(m + ea)) & WORD_MASK; NEXT(); }
+    HANDLER(MUL) {
+        CHECK_WORD();
+        a = static_cast<int>(int64_t(signExtend(a)) * signExtend(readWord(m + ea)) & WORD_MASK);
+        NEXT();
+    }
+    HANDLER(DIV) {
+        CHECK_WORD();
+        int divisor = signExtend(readWord(m + ea));
+        if (divisor == 0)
+            FAIL("Division by zero");
+        a = (signExtend(a) / divisor) & WORD_MASK;
+        NEXT();
+    }
+    HANDLER(AND) { CHECK_WORD(); a &= readWord(m + ea); NEXT(); }
+    HANDLER(OR) { CHECK_WORD(); a |= readWord(m + ea); NEXT(); }
+    HANDLER(COMP) { CHECK_WORD(); sw = compare(a, readWord(m + ea)); NEXT(); }
+    HANDLER(TIX) { CHECK_WORD(); x = (x + 1) & WORD_MASK; sw = compare(x, readWord(m + ea)); NEXT(); }
+    HANDLER(J) {
+        if (ea == pc - 3)
+            goto stop;              // J * ends a program
+        pc = ea;
+        NEXT();
+    }
+    HANDLER(JEQ) { if (sw == CC_EQ) pc = ea; NEXT(); }
+    HANDLER(JGT) { if (sw == CC_GT) pc = ea; NEXT(); }
+    HANDLER(JLT) { if (sw == CC_LT) pc = ea; NEXT(); }
+    HANDLER(JSUB) { l = pc; pc = ea; NEXT(); }
+    HANDLER(RSUB) { pc = l; NEXT(); }
+    HANDLER(TD) {
+        // File-backed devices are always ready
+        CHECK_BYTE();
+        sw = CC_LT;
+        NEXT();
+    }
+    HANDLER(RD) {
+        CHECK_BYTE();
+        FILE* file = device(m[ea], false);
+        if (!file)
+            FAIL("Device error");
+        int c = std::fgetc(file);
+        a = (a & 0xFFFF00) | (c == EOF ? 0 : c);    // End of file reads as zero
+        NEXT();
+    }
+    HANDLER(WD) {
+        CHECK_BYTE();
+        FILE* file = device(m[ea], true);
+        if (!file)
+            FAIL("Device error");
+        std::fputc(a & 0xFF, file);
+        NEXT();
+    }
+#if !SIM_COMPUTED_GOTO
+    default:
+        FAIL("Illegal instruction " + hex(m[pc - 3], 2));
+    }
+#endif
+
+stop:
+#undef CHECK_BYTE
+#undef CHECK_WORD
+#undef FAIL
+#undef NEXT
+#undef HANDLER
+#undef DISPATCH
+    if (pc != HALT_ADDRESS && static_cast<unsigned>(pc) > MEMORY_SIZE - 3 && ok)
+        ok = error("Jump to " + hex(pc, 6) + " outside memory");
+    reg_a = a;
+    reg_x = x;
+    reg_l = l;
+    reg_pc = pc;
+    reg_sw = sw;
+    executed = count;
+    for (Device& device : devices) {
+        if (device.file && device.writing)
+            std::fflush(device.file);
+    }
+    return ok;
+}
+
+#if SIM_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,79 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "binary.h"
+#include "optab.h"
+
+// SIC machine with 32K bytes of memory. Every address is pre-decoded into a
+// compact instruction (handler, index flag, address) so the dispatch loop
+// never looks at the raw bytes; stores re-decode the addresses they touch,
+// which keeps self-modifying code correct. Handlers are bound to opcode bytes
+// through the opcode table, so an --optab file renumbers them too.
+class Simulator {
+public:
+    static constexpr int MEMORY_SIZE = 1 << 15;
+    static constexpr int HALT_ADDRESS = 0xFFFFFF;  // Initial L: the final RSUB returns here
+
+    explicit Simulator(const Optab& optab);
+    ~Simulator();
+    Simulator(const Simulator&) = delete;
+    Simulator& operator=(const Simulator&) = delete;
+
+    bool load(const ObjectProgram& program);
+
+    // Devices are files. An unattached device XX opens the file named XX in
+    // the working directory the first time it is used.
+    void attach(int device, const std::string& filename);
+
+    // Run from the entry point until the program returns through the initial
+    // L, jumps to itself, or maxSteps instructions have run (0: no limit).
+    // Returns false on a machine error, which is reported through error().
+    bool run(uint64_t maxSteps = 0);
+
+    uint64_t steps() const { return executed; }
+    int a() const { return reg_a; }
+    int x() const { return reg_x; }
+    int l() const { return reg_l; }
+    int pc() const { return reg_pc; }
+    const unsigned char* memory() const { return mem.data(); }
+
+    enum Handler : uint8_t {
+        ILLEGAL, LDA, LDX, LDL, LDCH, STA, STX, STL, STCH, STSW,
+        ADD, SUB, MUL, DIV, AND, OR, COMP, TIX,
+        J, JEQ, JGT, JLT, JSUB, RSUB, TD, RD, WD,
+        HANDLER_COUNT
+    };
+
+private:
+    struct Decoded {
+        uint8_t handler;
+        uint8_t indexed;
+        uint16_t address;
+    };
+    static_assert(sizeof(Decoded) == 4, "Decoded instruction should stay compact");
+
+    struct Device {
+        std::string filename;
+        FILE* file = nullptr;
+        bool writing = false;
+        bool failed = false;
+    };
+
+    std::array<uint8_t, 256> handlers{};            // Opcode byte -> handler
+    std::vector<unsigned char> mem;
+    std::vector<Decoded> decoded;
+    std::array<Device, 256> devices;
+    int reg_a = 0, reg_x = 0, reg_l = HALT_ADDRESS, reg_pc = 0, reg_sw = 0;
+    uint64_t executed = 0;
+
+    void decode(int address);
+    void redecode(int address, int count);
+    FILE* device(int id, bool writing);
+};
+
+#endif // SIMULATOR_H
@@ -0,0 +1,152 @@
+#include "snapshot.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "error.h"
+
+static_assert(std::endian::native == std::endian::little, "snapshots are mapped in place and assume a little-endian host");
+
+namespace {
+
+constexpr char snapshot_magic[4] = {'S', 'I', 'C', 'S'};
+constexpr uint16_t snapshot_version = 1;
+
+// Name order first, then section, as the entries are sorted
+bool precedes(std::string_view name, uint32_t section, std::string_view otherName, uint32_t otherSection) {
+    int order = name.compare(otherName);
+    return order < 0 || (order == 0 && section < otherSection);
+}
+
+} // namespace
+
+std::string formatSnapshot(const SymbolTable& symtab, const BlockTable& blocks) {
+    // Sort keys rather than ids, so comparisons do not go back to symtab
+    struct Key {
+        std::string_view name;
+        uint32_t section;
+        int id;
+    };
+    std::vector<Key> ids;
+    ids.reserve(symtab.size());
+    for (int id = 0; id < symtab.size(); id++) {
+        if (symtab.defined(id))
+            ids.push_back(Key{symtab.name(id), static_cast<uint32_t>(symtab.section(id)), id});
+    }
+    std::sort(ids.begin(), ids.end(), [](const Key& a, const Key& b) {
+        return precedes(a.name, a.section, b.name, b.section);
+    });
+
+    SnapshotHeader head{};
+    std::memcpy(head.magic, snapshot_magic, 4);
+    head.version = snapshot_version;
+    head.header_size = sizeof(SnapshotHeader);
+    head.symbol_count = static_cast<uint32_t>(ids.size());
+    head.symbol_offset = sizeof(SnapshotHeader);
+    head.block_count = static_cast<uint32_t>(blocks.size());
+    head.block_offset = head.symbol_offset + head.symbol_count * sizeof(SnapshotSymbol);
+    head.names_offset = head.block_offset + head.block_count * sizeof(SnapshotBlock);
+
+    // Entries are fixed-size, so each one is written in place while the
+    // names are appended behind them
+    std::string out(head.names_offset, '\0');
+    auto addName = [&](std::string_view name) {
+        uint32_t offset = static_cast<uint32_t>(out.size() - head.names_offset);
+        out.append(name);
+        return offset;
+    };
+    for (size_t i = 0; i < ids.size(); i++) {
+        int id = ids[i].id;
+        std::string_view name = ids[i].name;
+        SnapshotSymbol entry{addName(name), static_cast<uint32_t>(name.size()), static_cast<uint32_t>(symtab.section(id)),
+                             static_cast<uint32_t>(symtab.block(id)), static_cast<uint32_t>(symtab.address(id))};
+        std::memcpy(out.data() + head.symbol_offset + i * sizeof(SnapshotSymbol), &entry, sizeof(entry));
+    }
+    for (int id = 0; id < blocks.size(); id++) {
+        std::string_view name = blocks.name(id);
+        SnapshotBlock entry{addName(name), static_cast<uint32_t>(name.size()), static_cast<uint32_t>(blocks.startAddress(id)),
+                            static_cast<uint32_t>(blocks.length(id))};
+        std::memcpy(out.data() + head.block_offset + id * sizeof(SnapshotBlock), &entry, sizeof(entry));
+    }
+    head.names_size = static_cast<uint32_t>(out.size() - head.names_offset);
+    head.file_size = static_cast<uint32_t>(out.size());
+    std::memcpy(out.data(), &head, sizeof(head));
+    return out;
+}
+
+bool writeSnapshot(const std::string& filename, const SymbolTable& symtab, const BlockTable& blocks) {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open())
+        return error("Unable to open file " + filename + " for writing.");
+    std::string contents = formatSnapshot(symtab, blocks);
+    out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    return static_cast<bool>(out) || error("Could not write snapshot " + filename);
+}
+
+SnapshotView::~SnapshotView() {
+    if (data)
+        munmap(const_cast<unsigned char*>(data), length);
+}
+
+bool SnapshotView::open(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return error("Could not open snapshot " + filename);
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(SnapshotHeader))) {
+        ::close(fd);
+        return error("Not a snapshot: " + filename);
+    }
+    length = static_cast<size_t>(info.st_size);
+    void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        length = 0;
+        return error("Could not map snapshot " + filename);
+    }
+    data = static_cast<const unsigned char*>(view);
+
+    // Validate once so symbol(), block() and name() can trust the offsets
+    const SnapshotHeader& head = header();
+    uint64_t symbolEnd = head.symbol_offset + uint64_t(head.symbol_count) * sizeof(SnapshotSymbol);
+    uint64_t blockEnd = head.block_offset + uint64_t(head.block_count) * sizeof(SnapshotBlock);
+    bool valid = std::memcmp(head.magic, snapshot_magic, 4) == 0 && head.version == snapshot_version &&
+                 head.file_size == length && head.symbol_offset % 4 == 0 && head.block_offset % 4 == 0 &&
+                 head.symbol_offset >= sizeof(SnapshotHeader) && symbolEnd <= head.block_offset &&
+                 blockEnd <= head.names_offset && uint64_t(head.names_offset) + head.names_size <= length;
+    for (uint32_t i = 0; valid && i < head.symbol_count; i++)
+        valid = uint64_t(symbol(i).name_offset) + symbol(i).name_length <= head.names_size;
+    for (uint32_t i = 0; valid && i < head.block_count; i++)
+        valid = uint64_t(block(i).name_offset) + block(i).name_length <= head.names_size;
+    if (!valid)
+        return error("Corrupt snapshot " + filename);
+    return true;
+}
+
+const SnapshotSymbol& SnapshotView::symbol(size_t i) const {
+    return reinterpret_cast<const SnapshotSymbol*>(data + header().symbol_offset)[i];
+}
+
+const SnapshotBlock& SnapshotView::block(size_t i) const {
+    return reinterpret_cast<const SnapshotBlock*>(data + header().block_offset)[i];
+}
+
+std::string_view SnapshotView::name(uint32_t offset, uint32_t size) const {
+    return std::string_view(reinterpret_cast<const char*>(data) + header().names_offset + offset, size);
+}
+
+const SnapshotSymbol* SnapshotView::find(std::string_view wanted, uint32_t section) const {
+    const SnapshotSymbol* first = reinterpret_cast<const SnapshotSymbol*>(data + header().symbol_offset);
+    const SnapshotSymbol* last = first + symbolCount();
+    const SnapshotSymbol* found = std::lower_bound(first, last, wanted, [&](const SnapshotSymbol& entry, std::string_view) {
+        return precedes(name(entry), entry.section, wanted, section);
+    });
+    if (found == last || found->section != section || name(*found) != wanted)
+        return nullptr;
+    return found;
+}
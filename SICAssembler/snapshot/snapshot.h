@@ -0,0 +1,82 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "block.h"
+#include "symtab.h"
+
+// Symbol and block snapshot (.snapshot), the binary alternative to the
+// .symbol.dump and .block.dump text files. All fields are little-endian and
+// naturally aligned so a mapped file can be searched in place:
+//
+//   SnapshotHeader
+//   symbols: symbol_count SnapshotSymbol entries, sorted by name, then section
+//   blocks:  block_count SnapshotBlock entries, indexed by block number
+//   names:   the names of both, unterminated, in the order of the entries
+struct SnapshotHeader {
+    char magic[4];                  // "SICS"
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t symbol_count;
+    uint32_t symbol_offset;
+    uint32_t block_count;
+    uint32_t block_offset;
+    uint32_t names_offset;
+    uint32_t names_size;
+    uint32_t file_size;
+    uint32_t reserved;
+};
+
+struct SnapshotSymbol {
+    uint32_t name_offset;           // Relative to names_offset
+    uint32_t name_length;
+    uint32_t section;               // Control section the name belongs to
+    uint32_t block;
+    uint32_t address;               // Relative to the start of its block
+};
+
+struct SnapshotBlock {
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint32_t start_address;         // 0 with the length until END
+    uint32_t length;
+};
+
+static_assert(sizeof(SnapshotHeader) == 40, "SnapshotHeader layout changed");
+static_assert(sizeof(SnapshotSymbol) == 20, "SnapshotSymbol layout changed");
+static_assert(sizeof(SnapshotBlock) == 16, "SnapshotBlock layout changed");
+
+// Snapshot of the same rows as the text dumps: defined symbols and every block
+std::string formatSnapshot(const SymbolTable& symtab, const BlockTable& blocks);
+bool writeSnapshot(const std::string& filename, const SymbolTable& symtab, const BlockTable& blocks);
+
+// Read-only mapping of a .snapshot file. Lookups binary-search the mapped
+// entries and allocate nothing.
+class SnapshotView {
+public:
+    SnapshotView() = default;
+    ~SnapshotView();
+    SnapshotView(const SnapshotView&) = delete;
+    SnapshotView& operator=(const SnapshotView&) = delete;
+
+    bool open(const std::string& filename);
+    const SnapshotHeader& header() const { return *reinterpret_cast<const SnapshotHeader*>(data); }
+    size_t symbolCount() const { return header().symbol_count; }
+    size_t blockCount() const { return header().block_count; }
+    const SnapshotSymbol& symbol(size_t i) const;
+    const SnapshotBlock& block(size_t i) const;
+    std::string_view name(const SnapshotSymbol& symbol) const { return name(symbol.name_offset, symbol.name_length); }
+    std::string_view name(const SnapshotBlock& block) const { return name(block.name_offset, block.name_length); }
+    // Symbol named name in section, or nullptr
+    const SnapshotSymbol* find(std::string_view name, uint32_t section = 0) const;
+
+private:
+    const unsigned char* data = nullptr;
+    size_t length = 0;
+
+    std::string_view name(uint32_t offset, uint32_t size) const;
+};
+
+#endif // SNAPSHOT_H
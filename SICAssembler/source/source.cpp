@@ -0,0 +1,108 @@
+#include "source.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceFile::~SourceFile() {
+    close();
+}
+
+bool SourceFile::open(const std::string& filename) {
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        length = static_cast<size_t>(info.st_size);
+        if (length == 0) {
+            ::close(fd);
+            return true;
+        }
+        void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            madvise(view, length, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(view);
+            mapped = true;
+            ::close(fd);
+            return true;
+        }
+    }
+
+    // Not mappable: read the whole stream
+    char chunk[1 << 16];
+    ssize_t count;
+    while ((count = ::read(fd, chunk, sizeof(chunk))) > 0)
+        buffer.append(chunk, static_cast<size_t>(count));
+    ::close(fd);
+    if (count < 0) {
+        buffer.clear();
+        return false;
+    }
+    data = buffer.data();
+    length = buffer.size();
+    return true;
+}
+
+void SourceFile::close() {
+    if (mapped)
+        munmap(const_cast<char*>(data), length);
+    data = nullptr;
+    length = 0;
+    mapped = false;
+    buffer.clear();
+}
+
+bool LineReader::next(std::string_view& line) {
+    if (rest.empty())
+        return false;
+    size_t end = rest.find('\n');
+    if (end == std::string_view::npos) {
+        line = rest;
+        rest = std::string_view();
+    } else {
+        line = rest.substr(0, end);
+        rest.remove_prefix(end + 1);
+    }
+    return true;
+}
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Remove and return the next whitespace separated token
+static std::string_view nextToken(std::string_view& text) {
+    size_t start = 0;
+    while (start < text.size() && isBlank(text[start]))
+        start++;
+    size_t end = start;
+    while (end < text.size() && !isBlank(text[end]))
+        end++;
+    std::string_view token = text.substr(start, end - start);
+    text.remove_prefix(end);
+    return token;
+}
+
+SourceLine splitLine(std::string_view line) {
+    SourceLine tokens;
+
+    // A ':' marks the end of a label
+    size_t colon_pos = line.find(':');
+    if (colon_pos != std::string_view::npos) {
+        std::string_view label = line.substr(0, colon_pos);
+        while (!label.empty() && isBlank(label.front()))
+            label.remove_prefix(1);
+        while (!label.empty() && isBlank(label.back()))
+            label.remove_suffix(1);
+        tokens.labelled = true;
+        tokens.label = label;
+        line.remove_prefix(colon_pos + 1);
+    }
+
+    tokens.operation = nextToken(line);
+    tokens.operand = nextToken(line);
+    return tokens;
+}
@@ -0,0 +1,50 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <string>
+#include <string_view>
+
+// Read-only view of a source file. Regular files are memory-mapped; anything
+// that cannot be mapped (pipes, character devices) is read into a buffer.
+class SourceFile {
+public:
+    SourceFile() = default;
+    ~SourceFile();
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    bool open(const std::string& filename);
+    void close();
+    std::string_view text() const { return std::string_view(data, length); }
+
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    std::string buffer;         // Fallback storage when mmap is not possible
+};
+
+// Tokens of one source line, all pointing into the source text
+struct SourceLine {
+    bool labelled = false;      // Line had a "label:" prefix
+    std::string_view label;
+    std::string_view operation;
+    std::string_view operand;   // First token after the operation
+};
+
+// Iterates over the lines of a text without copying them
+class LineReader {
+public:
+    explicit LineReader(std::string_view text) : rest(text) {}
+    bool next(std::string_view& line);
+
+private:
+    std::string_view rest;
+};
+
+// Split a line into label, operation and operand. The label is everything
+// before a ':', the operation and operand are the next two whitespace
+// separated tokens; anything after them is ignored.
+SourceLine splitLine(std::string_view line);
+
+#endif // SOURCE_H
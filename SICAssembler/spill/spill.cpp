@@ -0,0 +1,107 @@
+#include "spill.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include "error.h"
+
+SpillFile::~SpillFile() {
+    if (fd >= 0)
+        ::close(fd);
+}
+
+bool SpillFile::create() {
+    const char* directory = std::getenv("TMPDIR");
+    std::string path = std::string(directory && *directory ? directory : "/tmp") + "/sic_spill.XXXXXX";
+    fd = mkstemp(path.data());
+    if (fd < 0)
+        return error("Could not create a spill file in " + path.substr(0, path.rfind('/')));
+    unlink(path.c_str());
+    return true;
+}
+
+bool SpillFile::fail() {
+    failure = true;
+    return false;
+}
+
+bool SpillFile::flush() {
+    // After a failure the bytes are dropped, so memory stays bounded; the
+    // caller finds out through failed()
+    bool ok = !failure && (fd >= 0 || create());
+    size_t written = 0;
+    while (ok && written < tail.size()) {
+        ssize_t count = pwrite(fd, tail.data() + written, tail.size() - written, flushed + static_cast<int64_t>(written));
+        ok = count > 0;
+        written += ok ? static_cast<size_t>(count) : 0;
+    }
+    flushed += static_cast<int64_t>(tail.size());
+    tail.clear();
+    return ok || fail();
+}
+
+int64_t SpillFile::append(const void* data, size_t size) {
+    if (tail.size() + size > BUFFER_SIZE && !tail.empty())
+        flush();
+    int64_t offset = this->size();
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    tail.insert(tail.end(), bytes, bytes + size);
+    return offset;
+}
+
+bool SpillFile::read(int64_t offset, void* data, size_t size) {
+    unsigned char* bytes = static_cast<unsigned char*>(data);
+    if (offset < 0 || offset + static_cast<int64_t>(size) > this->size())
+        return fail();
+    // The part already in the file comes through the window, refilled from
+    // offset when it does not hold it; the rest is still buffered
+    while (size > 0 && offset < flushed) {
+        int64_t end = window_start + static_cast<int64_t>(window.size());
+        if (offset < window_start || offset >= end) {
+            window.resize(static_cast<size_t>(std::min<int64_t>(std::max(size, WINDOW_SIZE), flushed - offset)));
+            size_t filled = 0;
+            while (filled < window.size()) {
+                ssize_t count = pread(fd, window.data() + filled, window.size() - filled, offset + static_cast<int64_t>(filled));
+                if (count <= 0) {
+                    window.clear();
+                    return fail();
+                }
+                filled += static_cast<size_t>(count);
+            }
+            window_start = offset;
+            end = offset + static_cast<int64_t>(window.size());
+        }
+        size_t count = static_cast<size_t>(std::min<int64_t>(static_cast<int64_t>(size), end - offset));
+        std::memcpy(bytes, window.data() + (offset - window_start), count);
+        bytes += count;
+        offset += static_cast<int64_t>(count);
+        size -= count;
+    }
+    if (size > 0)
+        std::memcpy(bytes, tail.data() + (offset - flushed), size);
+    return true;
+}
+
+bool SpillFile::write(int64_t offset, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    if (offset < 0 || offset + static_cast<int64_t>(size) > this->size())
+        return fail();
+    while (size > 0 && offset < flushed) {
+        size_t part = static_cast<size_t>(std::min<int64_t>(static_cast<int64_t>(size), flushed - offset));
+        ssize_t count = pwrite(fd, bytes, part, offset);
+        if (count <= 0)
+            return fail();
+        // Keep the window the same as the file
+        int64_t from = std::max(offset, window_start);
+        int64_t to = std::min(offset + count, window_start + static_cast<int64_t>(window.size()));
+        if (from < to)
+            std::memcpy(window.data() + (from - window_start), bytes + (from - offset), static_cast<size_t>(to - from));
+        bytes += count;
+        offset += count;
+        size -= static_cast<size_t>(count);
+    }
+    if (size > 0)
+        std::memcpy(tail.data() + (offset - flushed), bytes, size);
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Scratch file for data that has to wait but should not stay in memory.
+// Entries are appended and can be read or rewritten later by offset, so
+// they can be linked into chains through offsets stored in them. The
+// newest bytes stay in a buffer until it fills, and reads go through a
+// small window, so appending, relinking recent entries and reading nearby
+// ones cost no system calls. The file, in $TMPDIR or /tmp, is only created
+// when the buffer first fills, and unlinked at once.
+class SpillFile {
+public:
+    SpillFile() = default;
+    ~SpillFile();
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    int64_t append(const void* data, size_t size);  // Offset of the new bytes
+    bool read(int64_t offset, void* data, size_t size);
+    bool write(int64_t offset, const void* data, size_t size);
+    int64_t size() const { return flushed + static_cast<int64_t>(tail.size()); }
+    bool failed() const { return failure; }
+
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+    static constexpr size_t WINDOW_SIZE = 1 << 12;
+
+    int fd = -1;
+    int64_t flushed = 0;                // Bytes already in the file
+    std::vector<unsigned char> tail;    // The bytes after them
+    std::vector<unsigned char> window;  // File bytes from window_start, last read
+    int64_t window_start = 0;
+    bool failure = false;
+
+    bool create();
+    bool flush();
+    bool fail();                        // Remember an I/O error, return false
+};
+
+#endif // SPILL_H
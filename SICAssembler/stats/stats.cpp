@@ -0,0 +1,89 @@
+#include "stats.h"
+#include <iomanip>
+
+namespace {
+
+thread_local size_t allocations = 0;
+thread_local size_t allocated = 0;
+
+} // namespace
+
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            const char* digits = "0123456789abcdef";
+            out += "\\u00";
+            out += digits[c >> 4];
+            out += digits[c & 0xf];
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+void countAllocation(size_t size) {
+    allocations++;
+    allocated += size;
+}
+
+size_t allocationCount() {
+    return allocations;
+}
+
+size_t allocatedBytes() {
+    return allocated;
+}
+
+void printStats(std::ostream& out, const std::string& name, const AssemblyStats& stats, StatsFormat format) {
+    const std::pair<const char*, size_t> counters[] = {
+        {"lines", stats.lines},
+        {"records", stats.records},
+        {"symbols", stats.symbols},
+        {"blocks", stats.blocks},
+        {"symbol_lookups", stats.symbol_lookups},
+        {"optab_lookups", stats.optab_lookups},
+        {"block_lookups", stats.block_lookups},
+        {"object_bytes", stats.object_bytes},
+        {"text_records", stats.text_records},
+        {"cache_hits", stats.cache_hits},
+        {"layout_hits", stats.layout_hits},
+        {"macro_expansions", stats.macro_expansions},
+        {"macro_hits", stats.macro_hits},
+        {"relax_rounds", stats.relax_rounds},
+        {"long_formats", stats.long_formats},
+        {"allocations", stats.allocations},
+        {"allocated_bytes", stats.allocated_bytes},
+    };
+    const std::pair<const char*, double> timings[] = {
+        {"pass1", stats.pass1_seconds},
+        {"dumps", stats.dump_seconds},
+        {"pass2", stats.pass2_seconds},
+        {"total", stats.total_seconds},
+    };
+
+    if (format == StatsFormat::JSON) {
+        // One object per line so batch output stays line-oriented
+        out << "{\"file\":" << jsonString(name) << ",\"seconds\":{";
+        for (size_t i = 0; i < std::size(timings); i++)
+            out << (i ? "," : "") << "\"" << timings[i].first << "\":" << std::fixed << std::setprecision(6) << timings[i].second;
+        out << "}";
+        for (const auto& counter : counters)
+            out << ",\"" << counter.first << "\":" << counter.second;
+        out << "}\n";
+        return;
+    }
+
+    if (format == StatsFormat::TEXT) {
+        out << "Statistics for " << name << "\n";
+        for (const auto& timing : timings)
+            out << "  " << std::left << std::setw(16) << timing.first << std::right << std::fixed
+                << std::setprecision(3) << std::setw(12) << timing.second * 1000 << " ms\n";
+        for (const auto& counter : counters)
+            out << "  " << std::left << std::setw(16) << counter.first << std::right << std::setw(12) << counter.second << "\n";
+    }
+}
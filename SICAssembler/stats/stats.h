@@ -0,0 +1,49 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+enum class StatsFormat { NONE, TEXT, JSON };
+
+// What one assembly did and where its time went
+struct AssemblyStats {
+    double pass1_seconds = 0;
+    double dump_seconds = 0;
+    double pass2_seconds = 0;
+    double total_seconds = 0;
+    size_t lines = 0;               // Source lines read
+    size_t records = 0;             // Lines decoded by pass1
+    size_t symbols = 0;             // Defined labels
+    size_t blocks = 0;              // USE blocks including the default one
+    size_t symbol_lookups = 0;
+    size_t optab_lookups = 0;
+    size_t block_lookups = 0;
+    size_t object_bytes = 0;
+    size_t text_records = 0;
+    size_t cache_hits = 0;          // Outputs copied from the cache, nothing assembled
+    size_t layout_hits = 0;         // Pass1 layout reused from the cache, only pass2 ran
+    size_t macro_expansions = 0;    // Distinct macro argument lists expanded
+    size_t macro_hits = 0;          // Invocations that reused an earlier expansion
+    size_t relax_rounds = 0;        // SIC/XE passes until every format 3/4 choice settled
+    size_t long_formats = 0;        // SIC/XE instructions relaxation moved to format 4
+    size_t allocations = 0;         // Heap allocations made by the assembling thread
+    size_t allocated_bytes = 0;
+};
+
+// Heap allocations made so far by the calling thread, as reported through
+// countAllocation(). The library leaves operator new alone; a program that
+// wants the counters replaces it and calls countAllocation(), as
+// sic_assembler does under --stats. Otherwise both stay 0. The counters are
+// thread-local so concurrent assemblies do not disturb each other.
+size_t allocationCount();
+size_t allocatedBytes();
+void countAllocation(size_t size);
+
+// Text as a JSON string literal, quotes included
+std::string jsonString(const std::string& text);
+
+void printStats(std::ostream& out, const std::string& name, const AssemblyStats& stats, StatsFormat format);
+
+#endif // STATS_H
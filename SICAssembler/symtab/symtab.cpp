@@ -0,0 +1,105 @@
+#include "symtab.h"
+#include <iostream>
+#include "error.h"
+#include <fstream>
+#include <iomanip>
+
+SymbolTable::SymbolTable() : slots(64, Slot{0, npos}) {}
+
+unsigned SymbolTable::hashName(std::string_view name) {
+    // FNV-1a
+    unsigned hash = 2166136261u;
+    for (char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Control sections other than the first get their own hash values
+unsigned SymbolTable::hashName(std::string_view name, int section) {
+    return hashName(name) ^ static_cast<unsigned>(section) * 2654435761u;
+}
+
+// Returns the slot holding name, or the empty slot where it would be inserted
+int SymbolTable::probe(std::string_view name, int section, unsigned hash) const {
+    size_t mask = slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Slot& slot = slots[i];
+        if (slot.id == npos)
+            return static_cast<int>(i);
+        if (slot.hash == hash && symbols[slot.id].section == section && this->name(slot.id) == name)
+            return static_cast<int>(i);
+    }
+}
+
+void SymbolTable::grow() {
+    std::vector<Slot> old(slots.size() * 2, Slot{0, npos});
+    old.swap(slots);
+    size_t mask = slots.size() - 1;
+    for (const Slot& slot : old) {
+        if (slot.id == npos)
+            continue;
+        size_t i = slot.hash & mask;
+        while (slots[i].id != npos)
+            i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+}
+
+int SymbolTable::intern(std::string_view name, int section) {
+    unsigned hash = hashName(name, section);
+    int index = probe(name, section, hash);
+    if (slots[index].id != npos)
+        return slots[index].id;
+
+    int id = size();
+    symbols.push_back(Symbol{undefined, 0, section, false, static_cast<unsigned>(names.size()), static_cast<unsigned>(name.size())});
+    names.append(name);
+    slots[index] = Slot{hash, id};
+
+    // Keep the load factor at or below one half
+    if (symbols.size() * 2 > slots.size())
+        grow();
+    return id;
+}
+
+int SymbolTable::find(std::string_view name, int section) const {
+    return slots[probe(name, section, hashName(name, section))].id;
+}
+
+void SymbolTable::define(int id, int address, int block) {
+    symbols[id].address = address;
+    symbols[id].block = block;
+}
+
+std::string_view SymbolTable::name(int id) const {
+    const Symbol& symbol = symbols[id];
+    return std::string_view(names).substr(symbol.name_offset, symbol.name_length);
+}
+
+void SymbolTable::clear() {
+    symbols.clear();
+    names.clear();
+    slots.assign(64, Slot{0, npos});
+}
+
+bool SymbolTable::dump(const std::string& filename) const {
+    std::ofstream outfile(filename);
+    if (!outfile.is_open()) {
+        return error("Unable to open file " + filename + " for writing.");
+    }
+    write(outfile);
+    return true;
+}
+
+void SymbolTable::write(std::ostream& out) const {
+    // Same layout as the original symbol dump so existing tools keep reading it
+    out << "label block value\n";
+    out << std::uppercase << std::hex << std::setfill('0');
+    for (int id = 0; id < size(); id++) {
+        if (!defined(id))
+            continue;
+        out << name(id) << " " << std::dec << block(id) << " " << std::hex << std::setw(4) << address(id) << '\n';
+    }
+}
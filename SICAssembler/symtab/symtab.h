@@ -0,0 +1,59 @@
+#ifndef SYMTAB_H
+#define SYMTAB_H
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Symbol table keyed by interned names. Symbols get dense integer ids so the
+// line records can refer to them directly; addresses and block numbers are
+// stored as integers. Lookups probe a flat open-addressing array and never
+// allocate. Every control section has its own names: the same label in two
+// sections gives two symbols.
+class SymbolTable {
+public:
+    static constexpr int npos = -1;
+    static constexpr int undefined = -1;
+
+    SymbolTable();
+    int intern(std::string_view name, int section = 0);     // Id for name, adding an undefined entry if new
+    int find(std::string_view name, int section = 0) const; // Id for name or npos
+    void define(int id, int address, int block);
+    void markExternal(int id) { symbols[id].external = true; } // Named by EXTREF, defined elsewhere
+    bool defined(int id) const { return symbols[id].address != undefined; }
+    bool external(int id) const { return symbols[id].external; }
+    int address(int id) const { return symbols[id].address; }
+    int block(int id) const { return symbols[id].block; }
+    int section(int id) const { return symbols[id].section; }
+    std::string_view name(int id) const;
+    int size() const { return static_cast<int>(symbols.size()); }
+    void clear();
+    bool dump(const std::string& filename) const;
+    void write(std::ostream& out) const;   // Same text as dump()
+
+private:
+    struct Symbol {
+        int address;                // Block-relative address, undefined until the label is seen
+        int block;                  // USE block the label was defined in
+        int section;                // Control section the name belongs to
+        bool external;
+        unsigned name_offset;       // Offset of the name in names
+        unsigned name_length;
+    };
+    struct Slot {
+        unsigned hash;
+        int id;                     // npos marks an empty slot
+    };
+
+    std::vector<Symbol> symbols;    // Indexed by symbol id
+    std::vector<Slot> slots;        // Power-of-two sized, linear probing
+    std::string names;              // Interned name storage
+
+    static unsigned hashName(std::string_view name);
+    static unsigned hashName(std::string_view name, int section);
+    int probe(std::string_view name, int section, unsigned hash) const;
+    void grow();
+};
+
+#endif // SYMTAB_H
@@ -0,0 +1,24 @@
+#include <iostream>
+#include "SICXEasm.h"
+#include "source.h"
+
+// Assembles a file through Assembler::assembleBuffer(), as a program
+// embedding libsicasm.a would, and prints the object program on stdout so
+// make check can compare it with the other modes
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::cerr << "Usage: sic_buffer <file.asm>\n";
+        return 1;
+    }
+    SourceFile source;
+    if (!source.open(argv[1])) {
+        std::cerr << "Could not open file " << argv[1] << '\n';
+        return 1;
+    }
+    std::unique_ptr<Assembler> sic = makeAssembler(Optab::builtin(), AssemblerOptions());
+    AssemblyResult result = sic->assembleBuffer(source.text());
+    for (const std::string& message : result.diagnostics)
+        std::cerr << argv[1] << ": " << message << '\n';
+    std::cout << result.object;
+    return result.ok ? 0 : 1;
+}
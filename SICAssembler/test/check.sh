@@ -0,0 +1,109 @@
+#!/bin/sh
+# Assemble the samples in every mode and compare the object programs with
+# test/expected. Run by make check from the SICAssembler directory, after
+# the tools are built. Streaming patches forward references with records
+# after END, so its records differ; what every mode must agree on is the
+# memory image, compared as the .sicb that sic_objconv makes of it.
+
+ASSEMBLER=./sic_assembler
+BUFFER=bin/sic_buffer
+OBJCONV=./sic_objconv
+WORK=bin/check
+SAMPLES="strcpy filecopy"
+LOAD_AND_GO_SAMPLES="filecopy"  # strcpy uses USE blocks, which need two passes
+failures=0
+
+rm -rf "$WORK"
+mkdir -p "$WORK"
+for sample in $SAMPLES; do
+    cp "test/$sample.asm" "$WORK/$sample.asm"
+    $OBJCONV --to binary "test/expected/$sample.obj" "$WORK/$sample.expected.sicb"
+done
+
+# compare <mode> <sample> <output> <expected>
+compare() {
+    if cmp -s "$4" "$3"; then
+        echo "ok      $1 $2"
+    else
+        echo "FAILED  $1 $2"
+        diff "$4" "$3"
+        failures=$((failures + 1))
+    fi
+}
+
+# image <mode> <sample> <object>: the object must load the expected image
+image() {
+    $OBJCONV --to binary "$3" "$WORK/$2.$1.sicb"
+    compare "$1 image" "$2" "$WORK/$2.$1.sicb" "$WORK/$2.expected.sicb"
+}
+
+# run <mode> <command...>: assemble, then check the .obj of every sample
+run() {
+    mode=$1
+    shift
+    rm -f "$WORK"/*.obj
+    "$@" >/dev/null || echo "$mode: exit status $?"
+    for sample in $SAMPLES; do
+        compare "$mode" "$sample" "$WORK/$sample.obj" "test/expected/$sample.obj"
+    done
+}
+
+run serial sh -c "for s in $SAMPLES; do $ASSEMBLER $WORK/\$s.asm || exit; done"
+for sample in $SAMPLES; do
+    image serial "$sample" "$WORK/$sample.obj"
+done
+run parallel $ASSEMBLER --batch -j 4 $(for s in $SAMPLES; do echo "$WORK/$s.asm"; done)
+# The second run takes every layout from the cache
+run cached sh -c "for s in $SAMPLES; do $ASSEMBLER --cache $WORK/cache $WORK/\$s.asm || exit; done"
+run cached sh -c "for s in $SAMPLES; do $ASSEMBLER --cache $WORK/cache $WORK/\$s.asm || exit; done"
+
+# An instruction operand is not part of the cached layout; one edited into
+# something pass1 rejects must fail as it does on a cold run
+printf 'EDIT:\tSTART\t0\n\tLDA\tVALUE\nVALUE:\tWORD\t5\n\tEND\tEDIT\n' > "$WORK/edit.asm"
+$ASSEMBLER --cache "$WORK/cache" "$WORK/edit.asm" || echo "cache edit: exit status $?"
+sed 's/LDA\tVALUE/LDA\t#5/' "$WORK/edit.asm" > "$WORK/edit.new" && mv "$WORK/edit.new" "$WORK/edit.asm"
+if $ASSEMBLER --cache "$WORK/cache" "$WORK/edit.asm" 2>/dev/null || [ -e "$WORK/edit.obj" ]; then
+    echo "FAILED  cached operand edit"
+    failures=$((failures + 1))
+else
+    echo "ok      cached operand edit"
+fi
+
+for sample in $SAMPLES; do
+    $ASSEMBLER - < "$WORK/$sample.asm" > "$WORK/$sample.stream" || echo "stream: exit status $?"
+    image stream "$sample" "$WORK/$sample.stream"
+    $BUFFER "$WORK/$sample.asm" > "$WORK/$sample.buffer" || echo "buffer: exit status $?"
+    compare buffer "$sample" "$WORK/$sample.buffer" "test/expected/$sample.obj"
+done
+
+# The .sicb the assembler writes, and the .obj taken through .sicb and
+# back, hold the same image
+for sample in $SAMPLES; do
+    $ASSEMBLER --format both "$WORK/$sample.asm" || echo "binary: exit status $?"
+    $OBJCONV --to text "$WORK/$sample.sicb" "$WORK/$sample.back.obj"
+    compare binary "$sample" "$WORK/$sample.sicb" "$WORK/$sample.expected.sicb"
+    image round-trip "$sample" "$WORK/$sample.back.obj"
+done
+
+for sample in $LOAD_AND_GO_SAMPLES; do
+    rm -f "$WORK/$sample.obj"
+    $ASSEMBLER --load-and-go "$WORK/$sample.asm" || echo "load-and-go: exit status $?"
+    compare load-and-go "$sample" "$WORK/$sample.obj" "test/expected/$sample.obj"
+    image load-and-go "$sample" "$WORK/$sample.obj"
+done
+
+# A daemon on a socket in the work directory, stopped however the script ends
+$ASSEMBLER --serve "$WORK/socket" -j 2 &
+daemon=$!
+trap 'kill $daemon 2>/dev/null' EXIT
+for attempt in 1 2 3 4 5 6 7 8 9 10; do
+    [ -S "$WORK/socket" ] && break
+    sleep 1
+done
+run remote sh -c "for s in $SAMPLES; do $ASSEMBLER --connect $WORK/socket $WORK/\$s.asm || exit; done"
+
+if [ "$failures" -ne 0 ]; then
+    echo "$failures comparisons failed"
+    exit 1
+fi
+echo "All comparisons passed"
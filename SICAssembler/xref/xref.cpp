@@ -0,0 +1,176 @@
+#include "xref.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "error.h"
+
+static_assert(std::endian::native == std::endian::little, "cross-references are mapped in place and assume a little-endian host");
+
+namespace {
+
+constexpr char xref_magic[4] = {'S', 'I', 'C', 'X'};
+constexpr uint16_t xref_version = 1;
+
+// Name order first, then section, as the symbols are sorted
+bool precedes(std::string_view name, uint32_t section, std::string_view otherName, uint32_t otherSection) {
+    int order = name.compare(otherName);
+    return order < 0 || (order == 0 && section < otherSection);
+}
+
+} // namespace
+
+void CrossReference::clear() {
+    definitions.clear();
+    sites.clear();
+}
+
+void CrossReference::define(int symbol, int line) {
+    if (symbol >= static_cast<int>(definitions.size()))
+        definitions.resize(symbol + 1);
+    definitions[symbol].line = line;
+}
+
+void CrossReference::place(int symbol, int address) {
+    if (symbol >= static_cast<int>(definitions.size()))
+        definitions.resize(symbol + 1);
+    definitions[symbol].address = address;
+}
+
+void CrossReference::use(int symbol, int line, int address, uint32_t flags) {
+    sites.push_back(Site{symbol, XrefUse{static_cast<uint32_t>(line), static_cast<uint32_t>(address), flags}});
+}
+
+std::string CrossReference::format(const SymbolTable& symtab) const {
+    // Posting lists are cut by a counting sort on the symbol id, which keeps
+    // each list in the order its sites were recorded
+    std::vector<uint32_t> counts(symtab.size(), 0);
+    for (const Site& site : sites)
+        counts[site.symbol]++;
+
+    struct Key {
+        std::string_view name;
+        uint32_t section;
+        int id;
+    };
+    std::vector<Key> keys;
+    for (int id = 0; id < symtab.size(); id++) {
+        if (symtab.defined(id) || symtab.external(id) || counts[id] > 0)
+            keys.push_back(Key{symtab.name(id), static_cast<uint32_t>(symtab.section(id)), id});
+    }
+    std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) {
+        return precedes(a.name, a.section, b.name, b.section);
+    });
+
+    XrefHeader head{};
+    std::memcpy(head.magic, xref_magic, 4);
+    head.version = xref_version;
+    head.header_size = sizeof(XrefHeader);
+    head.symbol_count = static_cast<uint32_t>(keys.size());
+    head.symbol_offset = sizeof(XrefHeader);
+    head.use_count = static_cast<uint32_t>(sites.size());
+    head.use_offset = head.symbol_offset + head.symbol_count * sizeof(XrefSymbol);
+    head.names_offset = head.use_offset + head.use_count * sizeof(XrefUse);
+
+    std::string out(head.names_offset, '\0');
+    std::vector<uint32_t> next(symtab.size(), 0);
+    uint32_t first = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        int id = keys[i].id;
+        Definition definition = id < static_cast<int>(definitions.size()) ? definitions[id] : Definition();
+        bool defined = symtab.defined(id);
+        XrefSymbol entry{static_cast<uint32_t>(out.size() - head.names_offset), static_cast<uint32_t>(keys[i].name.size()),
+                         keys[i].section, symtab.external(id) ? EXTERNAL : 0,
+                         static_cast<uint32_t>(defined ? definition.line : 0), static_cast<uint32_t>(defined ? definition.address : 0),
+                         first, counts[id]};
+        std::memcpy(out.data() + head.symbol_offset + i * sizeof(XrefSymbol), &entry, sizeof(entry));
+        out.append(keys[i].name);
+        next[id] = first;
+        first += counts[id];
+    }
+    for (const Site& site : sites)
+        std::memcpy(out.data() + head.use_offset + next[site.symbol]++ * sizeof(XrefUse), &site.use, sizeof(XrefUse));
+    head.names_size = static_cast<uint32_t>(out.size() - head.names_offset);
+    head.file_size = static_cast<uint32_t>(out.size());
+    std::memcpy(out.data(), &head, sizeof(head));
+    return out;
+}
+
+bool writeCrossReference(const std::string& filename, const CrossReference& xref, const SymbolTable& symtab) {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open())
+        return error("Unable to open file " + filename + " for writing.");
+    std::string contents = xref.format(symtab);
+    out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    return static_cast<bool>(out) || error("Could not write cross-reference " + filename);
+}
+
+XrefView::~XrefView() {
+    if (data)
+        munmap(const_cast<unsigned char*>(data), length);
+}
+
+bool XrefView::open(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return error("Could not open cross-reference " + filename);
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(XrefHeader))) {
+        ::close(fd);
+        return error("Not a cross-reference: " + filename);
+    }
+    length = static_cast<size_t>(info.st_size);
+    void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        length = 0;
+        return error("Could not map cross-reference " + filename);
+    }
+    data = static_cast<const unsigned char*>(view);
+
+    // Validate the header and the symbols once; the uses are only read
+    // when a lookup asks for them
+    const XrefHeader& head = header();
+    uint64_t symbolEnd = head.symbol_offset + uint64_t(head.symbol_count) * sizeof(XrefSymbol);
+    uint64_t useEnd = head.use_offset + uint64_t(head.use_count) * sizeof(XrefUse);
+    bool valid = std::memcmp(head.magic, xref_magic, 4) == 0 && head.version == xref_version &&
+                 head.file_size == length && head.symbol_offset % 4 == 0 && head.use_offset % 4 == 0 &&
+                 head.symbol_offset >= sizeof(XrefHeader) && symbolEnd <= head.use_offset &&
+                 useEnd <= head.names_offset && uint64_t(head.names_offset) + head.names_size <= length;
+    for (uint32_t i = 0; valid && i < head.symbol_count; i++) {
+        const XrefSymbol& entry = symbol(i);
+        valid = uint64_t(entry.name_offset) + entry.name_length <= head.names_size &&
+                uint64_t(entry.first_use) + entry.use_count <= head.use_count;
+    }
+    if (!valid)
+        return error("Corrupt cross-reference " + filename);
+    return true;
+}
+
+const XrefSymbol& XrefView::symbol(size_t i) const {
+    return reinterpret_cast<const XrefSymbol*>(data + header().symbol_offset)[i];
+}
+
+std::string_view XrefView::name(const XrefSymbol& symbol) const {
+    return std::string_view(reinterpret_cast<const char*>(data) + header().names_offset + symbol.name_offset, symbol.name_length);
+}
+
+std::span<const XrefUse> XrefView::uses(const XrefSymbol& symbol) const {
+    const XrefUse* first = reinterpret_cast<const XrefUse*>(data + header().use_offset);
+    return std::span<const XrefUse>(first + symbol.first_use, symbol.use_count);
+}
+
+const XrefSymbol* XrefView::find(std::string_view wanted, uint32_t section) const {
+    const XrefSymbol* first = reinterpret_cast<const XrefSymbol*>(data + header().symbol_offset);
+    const XrefSymbol* last = first + symbolCount();
+    const XrefSymbol* found = std::lower_bound(first, last, wanted, [&](const XrefSymbol& entry, std::string_view) {
+        return precedes(name(entry), entry.section, wanted, section);
+    });
+    if (found == last || found->section != section || name(*found) != wanted)
+        return nullptr;
+    return found;
+}
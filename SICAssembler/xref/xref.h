@@ -0,0 +1,110 @@
+#ifndef XREF_H
+#define XREF_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "symtab.h"
+
+// Cross-reference index (.xref): where every symbol is defined and used.
+// All fields are little-endian and naturally aligned so a mapped file can
+// be queried in place, touching only the entries a lookup needs:
+//
+//   XrefHeader
+//   symbols: symbol_count XrefSymbol entries, sorted by name, then section
+//   uses:    use_count XrefUse entries, one posting list per symbol, in
+//            symbol order; each list is in program order
+//   names:   the symbol names, unterminated, in symbol order
+struct XrefHeader {
+    char magic[4];                  // "SICX"
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t symbol_count;
+    uint32_t symbol_offset;
+    uint32_t use_count;
+    uint32_t use_offset;
+    uint32_t names_offset;
+    uint32_t names_size;
+    uint32_t file_size;
+    uint32_t reserved;
+};
+
+struct XrefSymbol {
+    uint32_t name_offset;           // Relative to names_offset
+    uint32_t name_length;
+    uint32_t section;               // Control section the name belongs to
+    uint32_t flags;                 // CrossReference::EXTERNAL
+    uint32_t line;                  // Line of the definition, 0 if not defined here
+    uint32_t address;               // Address in the program (or section)
+    uint32_t first_use;             // Index of the first of its use_count uses
+    uint32_t use_count;
+};
+
+struct XrefUse {
+    uint32_t line;
+    uint32_t address;               // Address of the using instruction
+    uint32_t flags;                 // CrossReference::INDEXED, IMMEDIATE, INDIRECT
+};
+
+static_assert(sizeof(XrefHeader) == 40, "XrefHeader layout changed");
+static_assert(sizeof(XrefSymbol) == 32, "XrefSymbol layout changed");
+static_assert(sizeof(XrefUse) == 12, "XrefUse layout changed");
+
+// Definition and use sites collected while a program is assembled. Sites
+// are appended by symbol id and only grouped into posting lists by format().
+class CrossReference {
+public:
+    static constexpr uint32_t INDEXED = 1, IMMEDIATE = 2, INDIRECT = 4;   // Use flags
+    static constexpr uint32_t EXTERNAL = 1;                             // Symbol flags
+
+    void clear();
+    void define(int symbol, int line);                  // The label's line, from pass1
+    void place(int symbol, int address);                // Its final address
+    void use(int symbol, int line, int address, uint32_t flags);
+    size_t uses() const { return sites.size(); }
+
+    // .xref image of every symbol that is defined, external or used
+    std::string format(const SymbolTable& symtab) const;
+
+private:
+    struct Definition {
+        int line = 0;
+        int address = 0;
+    };
+    struct Site {
+        int symbol;
+        XrefUse use;
+    };
+
+    std::vector<Definition> definitions;    // Indexed by symbol id, grown on demand
+    std::vector<Site> sites;                // In the order they were recorded
+};
+
+bool writeCrossReference(const std::string& filename, const CrossReference& xref, const SymbolTable& symtab);
+
+// Read-only mapping of a .xref file. find() binary-searches the symbols;
+// uses() is a view of the symbol's posting list in the map.
+class XrefView {
+public:
+    XrefView() = default;
+    ~XrefView();
+    XrefView(const XrefView&) = delete;
+    XrefView& operator=(const XrefView&) = delete;
+
+    bool open(const std::string& filename);
+    const XrefHeader& header() const { return *reinterpret_cast<const XrefHeader*>(data); }
+    size_t symbolCount() const { return header().symbol_count; }
+    const XrefSymbol& symbol(size_t i) const;
+    std::string_view name(const XrefSymbol& symbol) const;
+    std::span<const XrefUse> uses(const XrefSymbol& symbol) const;
+    // Symbol named name in section, or nullptr
+    const XrefSymbol* find(std::string_view name, uint32_t section = 0) const;
+
+private:
+    const unsigned char* data = nullptr;
+    size_t length = 0;
+};
+
+#endif // XREF_H